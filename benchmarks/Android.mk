@@ -40,6 +40,17 @@ benchmark_src_files = \
     time_benchmark.cpp \
     unistd_benchmark.cpp \
 
+# The frame-pointer backtrace benchmark needs frame pointers to walk, but
+# they'd skew everything else, so it's built on its own with them on.
+include $(CLEAR_VARS)
+LOCAL_MODULE := libbionic-benchmarks-backtrace
+LOCAL_MULTILIB := both
+LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
+LOCAL_CFLAGS += $(benchmark_c_flags) -fno-omit-frame-pointer
+LOCAL_C_INCLUDES += external/stlport/stlport bionic/ bionic/libstdc++/include
+LOCAL_SRC_FILES := backtrace_benchmark.cpp
+include $(BUILD_STATIC_LIBRARY)
+
 # Build benchmarks for the device (with bionic's .so). Run with:
 #   adb shell bionic-benchmarks
 include $(CLEAR_VARS)
@@ -51,6 +62,7 @@ LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
 LOCAL_CFLAGS += $(benchmark_c_flags)
 LOCAL_C_INCLUDES += external/stlport/stlport bionic/ bionic/libstdc++/include
 LOCAL_SHARED_LIBRARIES += libstlport
+LOCAL_WHOLE_STATIC_LIBRARIES += libbionic-benchmarks-backtrace
 LOCAL_SRC_FILES := $(benchmark_src_files)
 include $(BUILD_EXECUTABLE)
 
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "benchmark.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <unwind.h>
+
+#include "libc/bionic/debug_frame_pointer.h"
+
+// Compares the two ways the malloc debugging code can collect the backtraces
+// it records for each allocation (see libc.debug.malloc.backtrace).
+
+struct UnwindState {
+  uintptr_t* frames;
+  size_t frame_count;
+  size_t max_depth;
+};
+
+static _Unwind_Reason_Code UnwindCallback(_Unwind_Context* context, void* arg) {
+  UnwindState* state = static_cast<UnwindState*>(arg);
+  state->frames[state->frame_count++] = _Unwind_GetIP(context);
+  return (state->frame_count >= state->max_depth) ? _URC_END_OF_STACK : _URC_NO_REASON;
+}
+
+static void __attribute__((noinline)) CaptureUnwind(int iters, size_t depth) {
+  uintptr_t frames[64];
+  StartBenchmarkTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    UnwindState state = { frames, 0, depth };
+    _Unwind_Backtrace(UnwindCallback, &state);
+  }
+
+  StopBenchmarkTiming();
+}
+
+#if defined(HAVE_FRAME_POINTER_BACKTRACE)
+static void __attribute__((noinline)) CaptureFramePointers(int iters, size_t depth) {
+  uintptr_t frames[64];
+  pthread_attr_t attr;
+  pthread_getattr_np(pthread_self(), &attr);
+  void* stack_base;
+  size_t stack_size;
+  pthread_attr_getstack(&attr, &stack_base, &stack_size);
+  pthread_attr_destroy(&attr);
+  uintptr_t stack_lo = reinterpret_cast<uintptr_t>(stack_base);
+  uintptr_t stack_hi = stack_lo + stack_size;
+  StartBenchmarkTiming();
+
+  volatile size_t frame_count __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    frame_count += frame_pointer_backtrace(reinterpret_cast<uintptr_t>(__builtin_frame_address(0)),
+                                           stack_lo, stack_hi, frames, depth);
+    // The stack doesn't change between iterations, but walk it every time anyway.
+    asm volatile("" ::: "memory");
+  }
+
+  StopBenchmarkTiming();
+}
+#endif
+
+// Calls 'capture' with at least 'depth' frames on the stack below it.
+static int __attribute__((noinline)) Recurse(int depth, void (*capture)(int, size_t),
+                                             int iters, size_t max_depth) {
+  if (depth == 0) {
+    capture(iters, max_depth);
+    return 0;
+  }
+  int result = Recurse(depth - 1, capture, iters, max_depth);
+  // Stop the compiler turning this into a tail call and removing our frame.
+  asm volatile("" ::: "memory");
+  return result + 1;
+}
+
+static void BM_backtrace_unwind(int iters, int depth) {
+  StopBenchmarkTiming();
+  Recurse(depth, CaptureUnwind, iters, depth);
+}
+BENCHMARK(BM_backtrace_unwind)->Arg(8)->Arg(16)->Arg(32);
+
+#if defined(HAVE_FRAME_POINTER_BACKTRACE)
+static void BM_backtrace_frame_pointer(int iters, int depth) {
+  StopBenchmarkTiming();
+  Recurse(depth, CaptureFramePointers, iters, depth);
+}
+BENCHMARK(BM_backtrace_frame_pointer)->Arg(8)->Arg(16)->Arg(32);
+#endif
@@ -33,8 +33,12 @@ extern void *__system_property_area__;
 #define TEST_NUM_PROPS \
     Arg(1)->Arg(4)->Arg(16)->Arg(64)->Arg(128)->Arg(256)->Arg(512)
 
+// With deep_sorted_names, the properties are named like "ro.a.b.c.d.e.f.g.h.i.j.00042",
+// as deep as PROP_NAME_MAX allows, and added in order. That's the worst case
+// for the trie: the last level's binary tree degenerates into a list.
 struct LocalPropertyTestState {
-    LocalPropertyTestState(int nprops) : nprops(nprops), valid(false) {
+    LocalPropertyTestState(int nprops, bool deep_sorted_names = false)
+            : nprops(nprops), valid(false) {
         static const char prop_name_chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ-_.";
 
         const char* android_data = getenv("ANDROID_DATA");
@@ -62,12 +66,27 @@ struct LocalPropertyTestState {
 
         names = new char* [nprops];
         name_lens = new int[nprops];
+        missing_names = new char* [nprops];
         values = new char* [nprops];
         value_lens = new int[nprops];
 
         srandom(nprops);
 
         for (int i = 0; i < nprops; i++) {
+            missing_names[i] = new char[PROP_NAME_MAX + 3];
+            if (deep_sorted_names) {
+                names[i] = new char[PROP_NAME_MAX + 1];
+                name_lens[i] = snprintf(names[i], PROP_NAME_MAX, "%s.%05d", deep_prefix, i);
+                snprintf(missing_names[i], PROP_NAME_MAX, "%s.%05d", deep_prefix, nprops + i);
+                values[i] = new char[PROP_VALUE_MAX];
+                value_lens[i] = snprintf(values[i], PROP_VALUE_MAX, "%d", i);
+                if (__system_property_add(names[i], name_lens[i], values[i], value_lens[i]) < 0) {
+                    printf("Failed to add a property, terminating...\n");
+                    exit(1);
+                }
+                continue;
+            }
+
             // Make sure the name has at least 10 characters to make
             // it very unlikely to generate the same random name.
             name_lens[i] = (random() % (PROP_NAME_MAX - 10)) + 10;
@@ -87,6 +106,7 @@ struct LocalPropertyTestState {
                 names[i][j] = prop_name_chars[random() % prop_name_len];
             }
             names[i][name_lens[i]] = 0;
+            snprintf(missing_names[i], PROP_NAME_MAX + 3, "%s.x", names[i]);
 
             // Make sure the value contains at least 1 character.
             value_lens[i] = (random() % (PROP_VALUE_MAX - 1)) + 1;
@@ -116,10 +136,12 @@ struct LocalPropertyTestState {
         rmdir(pa_dirname.c_str());
 
         for (int i = 0; i < nprops; i++) {
-            delete names[i];
-            delete values[i];
+            delete[] names[i];
+            delete[] missing_names[i];
+            delete[] values[i];
         }
         delete[] names;
+        delete[] missing_names;
         delete[] name_lens;
         delete[] values;
         delete[] value_lens;
@@ -128,16 +150,22 @@ public:
     const int nprops;
     char **names;
     int *name_lens;
+    // Names that aren't properties, but are only one step from one.
+    char **missing_names;
     char **values;
     int *value_lens;
     bool valid;
 
 private:
+    static const char deep_prefix[];
+
     std::string pa_dirname;
     std::string pa_filename;
     void *old_pa;
 };
 
+const char LocalPropertyTestState::deep_prefix[] = "ro.a.b.c.d.e.f.g.h.i.j";
+
 static void BM_property_get(int iters, int nprops)
 {
     StopBenchmarkTiming();
@@ -179,6 +207,88 @@ static void BM_property_find(int iters, int nprops)
 }
 BENCHMARK(BM_property_find)->TEST_NUM_PROPS;
 
+static void BM_property_find_deep_sorted(int iters, int nprops)
+{
+    StopBenchmarkTiming();
+
+    LocalPropertyTestState pa(nprops, true);
+
+    if (!pa.valid)
+        return;
+
+    srandom(iters * nprops);
+
+    StartBenchmarkTiming();
+
+    for (int i = 0; i < iters; i++) {
+        __system_property_find(pa.names[random() % nprops]);
+    }
+    StopBenchmarkTiming();
+}
+BENCHMARK(BM_property_find_deep_sorted)->TEST_NUM_PROPS;
+
+// Lookups of properties that don't exist can't be cached, so these show the
+// cost of the lookup itself.
+static void BM_property_find_missing(int iters, int nprops)
+{
+    StopBenchmarkTiming();
+
+    LocalPropertyTestState pa(nprops);
+
+    if (!pa.valid)
+        return;
+
+    srandom(iters * nprops);
+
+    StartBenchmarkTiming();
+
+    for (int i = 0; i < iters; i++) {
+        __system_property_find(pa.missing_names[random() % nprops]);
+    }
+    StopBenchmarkTiming();
+}
+BENCHMARK(BM_property_find_missing)->TEST_NUM_PROPS;
+
+static void BM_property_find_missing_deep_sorted(int iters, int nprops)
+{
+    StopBenchmarkTiming();
+
+    LocalPropertyTestState pa(nprops, true);
+
+    if (!pa.valid)
+        return;
+
+    srandom(iters * nprops);
+
+    StartBenchmarkTiming();
+
+    for (int i = 0; i < iters; i++) {
+        __system_property_find(pa.missing_names[random() % nprops]);
+    }
+    StopBenchmarkTiming();
+}
+BENCHMARK(BM_property_find_missing_deep_sorted)->TEST_NUM_PROPS;
+
+static void BM_property_handle_get(int iters, int nprops)
+{
+    StopBenchmarkTiming();
+
+    LocalPropertyTestState pa(nprops);
+
+    if (!pa.valid)
+        return;
+
+    prop_handle handle = PROP_HANDLE_INITIALIZER(pa.names[0]);
+
+    StartBenchmarkTiming();
+
+    for (int i = 0; i < iters; i++) {
+        __system_property_handle_get(&handle);
+    }
+    StopBenchmarkTiming();
+}
+BENCHMARK(BM_property_handle_get)->TEST_NUM_PROPS;
+
 static void BM_property_read(int iters, int nprops)
 {
     StopBenchmarkTiming();
@@ -17,6 +17,9 @@
 #include "benchmark.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #define KB 1024
 #define MB 1024*KB
@@ -25,6 +28,9 @@
     Arg(1)->Arg(2)->Arg(3)->Arg(4)->Arg(8)->Arg(16)->Arg(32)->Arg(64)->Arg(512)-> \
     Arg(1*KB)->Arg(4*KB)->Arg(8*KB)->Arg(16*KB)->Arg(64*KB)
 
+#define AT_LARGE_FILE_SIZES \
+    Arg(1*MB)->Arg(4*MB)->Arg(16*MB)
+
 static void BM_stdio_fread(int iters, int chunk_size) {
   StopBenchmarkTiming();
   FILE* fp = fopen("/dev/zero", "rw");
@@ -59,3 +65,153 @@ static void BM_stdio_fwrite(int iters, int chunk_size) {
   fclose(fp);
 }
 BENCHMARK(BM_stdio_fwrite)->AT_COMMON_SIZES;
+
+// Creates a file of 'size' bytes made of 80-character lines, and returns its
+// name in 'path'. Like TemporaryFile, this tries the device's temporary
+// directory first and falls back to the host's.
+static bool MakeLargeFile(char* path, size_t path_size, int size) {
+  snprintf(path, path_size, "/data/local/tmp/stdio_benchmark-XXXXXX");
+  int fd = mkstemp(path);
+  if (fd == -1) {
+    snprintf(path, path_size, "/tmp/stdio_benchmark-XXXXXX");
+    fd = mkstemp(path);
+    if (fd == -1) {
+      return false;
+    }
+  }
+
+  char line[80];
+  memset(line, 'x', sizeof(line) - 1);
+  line[sizeof(line) - 1] = '\n';
+  for (int written = 0; written < size; written += sizeof(line)) {
+    if (write(fd, line, sizeof(line)) != static_cast<ssize_t>(sizeof(line))) {
+      close(fd);
+      unlink(path);
+      return false;
+    }
+  }
+  close(fd);
+  return true;
+}
+
+static void BM_stdio_fgets_large_file(int iters, int file_size) {
+  StopBenchmarkTiming();
+  char path[1024];
+  if (!MakeLargeFile(path, sizeof(path), file_size)) {
+    return;
+  }
+  char line[128];
+  StartBenchmarkTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    FILE* fp = fopen(path, "re");
+    while (fgets(line, sizeof(line), fp) != NULL) {
+    }
+    fclose(fp);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(file_size));
+  unlink(path);
+}
+BENCHMARK(BM_stdio_fgets_large_file)->AT_LARGE_FILE_SIZES;
+
+static void BM_stdio_fread_large_file(int iters, int file_size) {
+  StopBenchmarkTiming();
+  char path[1024];
+  if (!MakeLargeFile(path, sizeof(path), file_size)) {
+    return;
+  }
+  char* buf = new char[4*KB];
+  StartBenchmarkTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    FILE* fp = fopen(path, "re");
+    while (fread(buf, 4*KB, 1, fp) == 1) {
+    }
+    fclose(fp);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(file_size));
+  delete[] buf;
+  unlink(path);
+}
+BENCHMARK(BM_stdio_fread_large_file)->AT_LARGE_FILE_SIZES;
+
+// The snprintf benchmarks vary their arguments so that nothing can be
+// constant-folded, and format into a buffer on the stack like typical
+// serialization code.
+static void BM_stdio_snprintf_d(int iters) {
+  char buf[64];
+  StartBenchmarkTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    snprintf(buf, sizeof(buf), "%d", i * 7919);
+  }
+
+  StopBenchmarkTiming();
+}
+BENCHMARK(BM_stdio_snprintf_d);
+
+static void BM_stdio_snprintf_lld(int iters) {
+  char buf[64];
+  StartBenchmarkTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(i) * 1000003LL * 7919LL);
+  }
+
+  StopBenchmarkTiming();
+}
+BENCHMARK(BM_stdio_snprintf_lld);
+
+static void BM_stdio_snprintf_f(int iters) {
+  char buf[64];
+  StartBenchmarkTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    snprintf(buf, sizeof(buf), "%f", i * 0.37);
+  }
+
+  StopBenchmarkTiming();
+}
+BENCHMARK(BM_stdio_snprintf_f);
+
+static void BM_stdio_snprintf_g(int iters) {
+  char buf[64];
+  StartBenchmarkTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    snprintf(buf, sizeof(buf), "%g", i * 0.37);
+  }
+
+  StopBenchmarkTiming();
+}
+BENCHMARK(BM_stdio_snprintf_g);
+
+static void BM_stdio_snprintf_s(int iters) {
+  char buf[64];
+  const char* strings[] = { "metric", "latency_ms", "a much longer string value" };
+  StartBenchmarkTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    snprintf(buf, sizeof(buf), "%s", strings[i % 3]);
+  }
+
+  StopBenchmarkTiming();
+}
+BENCHMARK(BM_stdio_snprintf_s);
+
+static void BM_stdio_snprintf_mixed(int iters) {
+  char buf[128];
+  StartBenchmarkTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    snprintf(buf, sizeof(buf), "{\"name\":\"%s\",\"count\":%d,\"mean\":%.3f}",
+             "latency", i, i * 0.5);
+  }
+
+  StopBenchmarkTiming();
+}
+BENCHMARK(BM_stdio_snprintf_mixed);
@@ -16,7 +16,12 @@
 
 #include "benchmark.h"
 
+#include <malloc.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <wchar.h>
 
 #define KB 1024
 #define MB 1024*KB
@@ -24,7 +29,69 @@
 #define AT_COMMON_SIZES \
     Arg(8)->Arg(64)->Arg(512)->Arg(1*KB)->Arg(8*KB)->Arg(16*KB)->Arg(32*KB)->Arg(64*KB)
 
-// TODO: test unaligned operation too? (currently everything will be 8-byte aligned by malloc.)
+// Where a mismatch or terminator is placed. The small sizes straddle the
+// 16/32/64-byte block boundaries the assembly implementations switch on.
+#define AT_POSITIONS \
+    Arg(1)->Arg(3)->Arg(7)->Arg(15)->Arg(16)->Arg(31)->Arg(32)->Arg(63)->Arg(64)->Arg(127)-> \
+    Arg(255)->Arg(1*KB)->Arg(4*KB)->Arg(64*KB)
+
+// For the "mix" benchmarks, the largest call size in the mix.
+#define AT_MIX_SIZES \
+    Arg(16)->Arg(64)->Arg(256)->Arg(1*KB)->Arg(4*KB)
+
+// Comfortably larger than the last-level cache of anything we run on, so
+// cycling through it means every call starts with cold data.
+#define COLD_CACHE_SIZE (64*MB)
+
+// A heap buffer whose data starts `misalignment` bytes past a 64-byte
+// boundary, so the same routine can be timed on aligned and unaligned data.
+class Buffer {
+ public:
+  Buffer(size_t size, size_t misalignment)
+      : base_(reinterpret_cast<char*>(memalign(64, size + 64))), data_(base_ + misalignment) {
+  }
+  ~Buffer() { free(base_); }
+
+  char* get() { return data_; }
+
+ private:
+  char* base_;
+  char* data_;
+};
+
+// A repeatable list of calls whose sizes are log-uniformly distributed
+// between 1 and `max_size` bytes, at random alignments. Traces of real
+// programs look like this: mostly small calls with a long tail of big ones,
+// which stresses the size dispatch rather than any one loop.
+struct SizeMix {
+  static const int kCalls = 1024;
+
+  SizeMix(int max_size) : total_bytes(0) {
+    srandom(max_size);
+    for (int i = 0; i < kCalls; ++i) {
+      double r = static_cast<double>(random()) / RAND_MAX;
+      sizes[i] = static_cast<size_t>(exp(r * log(max_size)));
+      if (sizes[i] < 1) sizes[i] = 1;
+      if (sizes[i] > static_cast<size_t>(max_size)) sizes[i] = max_size;
+      src_offsets[i] = random() % 64;
+      dst_offsets[i] = random() % 64;
+      total_bytes += sizes[i];
+    }
+  }
+
+  size_t sizes[kCalls];
+  size_t src_offsets[kCalls];
+  size_t dst_offsets[kCalls];
+  int64_t total_bytes;
+};
+
+// The offset of the i'th call in a cold-cache benchmark: successive calls
+// walk through a COLD_CACHE_SIZE region and wrap around at its end.
+static size_t ColdOffset(int i, int nbytes) {
+  size_t stride = (nbytes + 64 + 63) & ~63;
+  size_t slots = (COLD_CACHE_SIZE - nbytes - 64) / stride;
+  return (static_cast<size_t>(i) % slots) * stride;
+}
 
 static void BM_string_memcmp(int iters, int nbytes) {
   StopBenchmarkTiming();
@@ -110,3 +177,706 @@ static void BM_string_strlen(int iters, int nbytes) {
   delete[] s;
 }
 BENCHMARK(BM_string_strlen)->AT_COMMON_SIZES;
+
+static void BM_string_strcmp(int iters, int nbytes) {
+  StopBenchmarkTiming();
+  char* s1 = new char[nbytes]; char* s2 = new char[nbytes];
+  memset(s1, 'x', nbytes);
+  memset(s2, 'x', nbytes);
+  s1[nbytes - 1] = s2[nbytes - 1] = 0;
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += strcmp(s1, s2);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+  delete[] s1;
+  delete[] s2;
+}
+BENCHMARK(BM_string_strcmp)->AT_COMMON_SIZES;
+
+static void BM_string_strncmp(int iters, int nbytes) {
+  StopBenchmarkTiming();
+  char* s1 = new char[nbytes]; char* s2 = new char[nbytes];
+  memset(s1, 'x', nbytes);
+  memset(s2, 'x', nbytes);
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += strncmp(s1, s2, nbytes);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+  delete[] s1;
+  delete[] s2;
+}
+BENCHMARK(BM_string_strncmp)->AT_COMMON_SIZES;
+
+static void BM_string_strcpy(int iters, int nbytes) {
+  StopBenchmarkTiming();
+  char* src = new char[nbytes]; char* dst = new char[nbytes];
+  memset(src, 'x', nbytes);
+  src[nbytes - 1] = 0;
+  StartBenchmarkTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    strcpy(dst, src);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+  delete[] src;
+  delete[] dst;
+}
+BENCHMARK(BM_string_strcpy)->AT_COMMON_SIZES;
+
+static void BM_string_memchr(int iters, int nbytes) {
+  StopBenchmarkTiming();
+  char* s = new char[nbytes];
+  memset(s, 'x', nbytes);
+  s[nbytes - 1] = 'y';
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += (memchr(s, 'y', nbytes) != NULL);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+  delete[] s;
+}
+BENCHMARK(BM_string_memchr)->AT_COMMON_SIZES;
+
+static void BM_string_strchr(int iters, int nbytes) {
+  StopBenchmarkTiming();
+  char* s = new char[nbytes];
+  memset(s, 'x', nbytes);
+  s[nbytes - 2] = 'y';
+  s[nbytes - 1] = 0;
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += (strchr(s, 'y') != NULL);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+  delete[] s;
+}
+BENCHMARK(BM_string_strchr)->AT_COMMON_SIZES;
+
+static void BM_string_strrchr(int iters, int nbytes) {
+  StopBenchmarkTiming();
+  char* s = new char[nbytes];
+  memset(s, 'x', nbytes);
+  s[0] = 'y'; // strrchr has to scan to the terminator regardless.
+  s[nbytes - 1] = 0;
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += (strrchr(s, 'y') != NULL);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+  delete[] s;
+}
+BENCHMARK(BM_string_strrchr)->AT_COMMON_SIZES;
+
+// Fills `s` with pseudo-random lowercase text, which gives the first-byte
+// filters in strstr and memmem a realistic number of false candidates.
+static void FillText(char* s, int n) {
+  srandom(n);
+  for (int i = 0; i < n; ++i) {
+    s[i] = 'a' + random() % 26;
+  }
+}
+
+static void BM_string_strstr(int iters, int nbytes) {
+  StopBenchmarkTiming();
+  char* haystack = new char[nbytes + 16];
+  FillText(haystack, nbytes);
+  const char* needle = "needle12";
+  strcpy(haystack + nbytes, needle);
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += (strstr(haystack, needle) != NULL);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+  delete[] haystack;
+}
+BENCHMARK(BM_string_strstr)->AT_COMMON_SIZES;
+
+// A haystack of "aaa...a" and a needle of "aaa...ab": every position is a
+// near-match, which is quadratic for a naive search.
+static void BM_string_strstr_worst_case(int iters, int nbytes) {
+  StopBenchmarkTiming();
+  char* haystack = new char[nbytes + 1];
+  memset(haystack, 'a', nbytes);
+  haystack[nbytes] = 0;
+  char needle[64];
+  memset(needle, 'a', sizeof(needle) - 2);
+  needle[sizeof(needle) - 2] = 'b';
+  needle[sizeof(needle) - 1] = 0;
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += (strstr(haystack, needle) != NULL);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+  delete[] haystack;
+}
+BENCHMARK(BM_string_strstr_worst_case)->AT_COMMON_SIZES;
+
+static void BM_string_memmem(int iters, int nbytes) {
+  StopBenchmarkTiming();
+  char* haystack = new char[nbytes + 8];
+  FillText(haystack, nbytes);
+  const char* needle = "needle12";
+  memcpy(haystack + nbytes, needle, 8);
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += (memmem(haystack, nbytes + 8, needle, 8) != NULL);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+  delete[] haystack;
+}
+BENCHMARK(BM_string_memmem)->AT_COMMON_SIZES;
+
+static void BM_string_memmem_worst_case(int iters, int nbytes) {
+  StopBenchmarkTiming();
+  char* haystack = new char[nbytes];
+  memset(haystack, 'a', nbytes);
+  char needle[64];
+  memset(needle, 'a', sizeof(needle) - 1);
+  needle[sizeof(needle) - 1] = 'b';
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += (memmem(haystack, nbytes, needle, sizeof(needle)) != NULL);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+  delete[] haystack;
+}
+BENCHMARK(BM_string_memmem_worst_case)->AT_COMMON_SIZES;
+
+// The wide-character benchmarks take their size in bytes too, so their
+// throughput is directly comparable with the narrow versions.
+
+static void BM_string_wcslen(int iters, int nbytes) {
+  StopBenchmarkTiming();
+  int n = nbytes / sizeof(wchar_t);
+  wchar_t* s = new wchar_t[n];
+  wmemset(s, L'x', n);
+  s[n - 1] = 0;
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += wcslen(s);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+  delete[] s;
+}
+BENCHMARK(BM_string_wcslen)->AT_COMMON_SIZES;
+
+static void BM_string_wcscmp(int iters, int nbytes) {
+  StopBenchmarkTiming();
+  int n = nbytes / sizeof(wchar_t);
+  wchar_t* s1 = new wchar_t[n]; wchar_t* s2 = new wchar_t[n];
+  wmemset(s1, L'x', n);
+  wmemset(s2, L'x', n);
+  s1[n - 1] = s2[n - 1] = 0;
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += wcscmp(s1, s2);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+  delete[] s1;
+  delete[] s2;
+}
+BENCHMARK(BM_string_wcscmp)->AT_COMMON_SIZES;
+
+static void BM_string_wcschr(int iters, int nbytes) {
+  StopBenchmarkTiming();
+  int n = nbytes / sizeof(wchar_t);
+  wchar_t* s = new wchar_t[n];
+  wmemset(s, L'x', n);
+  s[n - 2] = L'y';
+  s[n - 1] = 0;
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += (wcschr(s, L'y') != NULL);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+  delete[] s;
+}
+BENCHMARK(BM_string_wcschr)->AT_COMMON_SIZES;
+
+static void BM_string_wcsrchr(int iters, int nbytes) {
+  StopBenchmarkTiming();
+  int n = nbytes / sizeof(wchar_t);
+  wchar_t* s = new wchar_t[n];
+  wmemset(s, L'x', n);
+  s[0] = L'y';
+  s[n - 1] = 0;
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += (wcsrchr(s, L'y') != NULL);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+  delete[] s;
+}
+BENCHMARK(BM_string_wcsrchr)->AT_COMMON_SIZES;
+
+static void BM_string_wmemcmp(int iters, int nbytes) {
+  StopBenchmarkTiming();
+  int n = nbytes / sizeof(wchar_t);
+  wchar_t* s1 = new wchar_t[n]; wchar_t* s2 = new wchar_t[n];
+  wmemset(s1, L'x', n);
+  wmemset(s2, L'x', n);
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += wmemcmp(s1, s2, n);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+  delete[] s1;
+  delete[] s2;
+}
+BENCHMARK(BM_string_wmemcmp)->AT_COMMON_SIZES;
+
+// Alignment sweeps. Each BENCHMARK_ALIGNED(fn, src, dst) line registers
+// fn_align_<src>_<dst>, which runs fn_aligned with its source and
+// destination starting that many bytes past a 64-byte boundary.
+
+#define BENCHMARK_ALIGNED(fn, src_alignment, dst_alignment) \
+  static void fn##_align_##src_alignment##_##dst_alignment(int iters, int nbytes) { \
+    fn##_aligned(iters, nbytes, src_alignment, dst_alignment); \
+  } \
+  BENCHMARK(fn##_align_##src_alignment##_##dst_alignment)->AT_COMMON_SIZES
+
+static void BM_string_memcpy_aligned(int iters, int nbytes, int src_alignment, int dst_alignment) {
+  StopBenchmarkTiming();
+  Buffer src(nbytes, src_alignment);
+  Buffer dst(nbytes, dst_alignment);
+  memset(src.get(), 'x', nbytes);
+  StartBenchmarkTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    memcpy(dst.get(), src.get(), nbytes);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+}
+BENCHMARK_ALIGNED(BM_string_memcpy, 0, 0);
+BENCHMARK_ALIGNED(BM_string_memcpy, 1, 0);
+BENCHMARK_ALIGNED(BM_string_memcpy, 0, 1);
+BENCHMARK_ALIGNED(BM_string_memcpy, 1, 3);
+BENCHMARK_ALIGNED(BM_string_memcpy, 15, 15);
+BENCHMARK_ALIGNED(BM_string_memcpy, 32, 0);
+
+static void BM_string_memset_aligned(int iters, int nbytes, int, int dst_alignment) {
+  StopBenchmarkTiming();
+  Buffer dst(nbytes, dst_alignment);
+  StartBenchmarkTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    memset(dst.get(), 0, nbytes);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+}
+BENCHMARK_ALIGNED(BM_string_memset, 0, 1);
+BENCHMARK_ALIGNED(BM_string_memset, 0, 15);
+BENCHMARK_ALIGNED(BM_string_memset, 0, 32);
+
+static void BM_string_memcmp_aligned(int iters, int nbytes, int src_alignment, int dst_alignment) {
+  StopBenchmarkTiming();
+  Buffer src(nbytes, src_alignment);
+  Buffer dst(nbytes, dst_alignment);
+  memset(src.get(), 'x', nbytes);
+  memset(dst.get(), 'x', nbytes);
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += memcmp(dst.get(), src.get(), nbytes);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+}
+BENCHMARK_ALIGNED(BM_string_memcmp, 1, 0);
+BENCHMARK_ALIGNED(BM_string_memcmp, 1, 3);
+BENCHMARK_ALIGNED(BM_string_memcmp, 15, 15);
+
+static void BM_string_strlen_aligned(int iters, int nbytes, int src_alignment, int) {
+  StopBenchmarkTiming();
+  Buffer s(nbytes, src_alignment);
+  memset(s.get(), 'x', nbytes);
+  s.get()[nbytes - 1] = 0;
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += strlen(s.get());
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+}
+BENCHMARK_ALIGNED(BM_string_strlen, 1, 0);
+BENCHMARK_ALIGNED(BM_string_strlen, 15, 0);
+BENCHMARK_ALIGNED(BM_string_strlen, 63, 0);
+
+static void BM_string_strcmp_aligned(int iters, int nbytes, int src_alignment, int dst_alignment) {
+  StopBenchmarkTiming();
+  Buffer s1(nbytes, src_alignment);
+  Buffer s2(nbytes, dst_alignment);
+  memset(s1.get(), 'x', nbytes);
+  memset(s2.get(), 'x', nbytes);
+  s1.get()[nbytes - 1] = s2.get()[nbytes - 1] = 0;
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += strcmp(s1.get(), s2.get());
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+}
+BENCHMARK_ALIGNED(BM_string_strcmp, 1, 0);
+BENCHMARK_ALIGNED(BM_string_strcmp, 1, 3);
+BENCHMARK_ALIGNED(BM_string_strcmp, 15, 15);
+
+static void BM_string_strcpy_aligned(int iters, int nbytes, int src_alignment, int dst_alignment) {
+  StopBenchmarkTiming();
+  Buffer src(nbytes, src_alignment);
+  Buffer dst(nbytes, dst_alignment);
+  memset(src.get(), 'x', nbytes);
+  src.get()[nbytes - 1] = 0;
+  StartBenchmarkTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    strcpy(dst.get(), src.get());
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+}
+BENCHMARK_ALIGNED(BM_string_strcpy, 1, 0);
+BENCHMARK_ALIGNED(BM_string_strcpy, 1, 3);
+
+// Position sweeps: the argument is the offset of the first difference (or the
+// character searched for) in an otherwise much longer buffer, so these time
+// the early exits rather than the bulk loops.
+
+#define POSITION_BUFFER_SIZE (128*KB)
+
+static void BM_string_memcmp_mismatch(int iters, int pos) {
+  StopBenchmarkTiming();
+  char* s1 = new char[POSITION_BUFFER_SIZE]; char* s2 = new char[POSITION_BUFFER_SIZE];
+  memset(s1, 'x', POSITION_BUFFER_SIZE);
+  memset(s2, 'x', POSITION_BUFFER_SIZE);
+  s2[pos] = 'y';
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += memcmp(s1, s2, POSITION_BUFFER_SIZE);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(pos + 1));
+  delete[] s1;
+  delete[] s2;
+}
+BENCHMARK(BM_string_memcmp_mismatch)->AT_POSITIONS;
+
+static void BM_string_strcmp_mismatch(int iters, int pos) {
+  StopBenchmarkTiming();
+  char* s1 = new char[POSITION_BUFFER_SIZE]; char* s2 = new char[POSITION_BUFFER_SIZE];
+  memset(s1, 'x', POSITION_BUFFER_SIZE);
+  memset(s2, 'x', POSITION_BUFFER_SIZE);
+  s1[POSITION_BUFFER_SIZE - 1] = s2[POSITION_BUFFER_SIZE - 1] = 0;
+  s2[pos] = 'y';
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += strcmp(s1, s2);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(pos + 1));
+  delete[] s1;
+  delete[] s2;
+}
+BENCHMARK(BM_string_strcmp_mismatch)->AT_POSITIONS;
+
+static void BM_string_strncmp_mismatch(int iters, int pos) {
+  StopBenchmarkTiming();
+  char* s1 = new char[POSITION_BUFFER_SIZE]; char* s2 = new char[POSITION_BUFFER_SIZE];
+  memset(s1, 'x', POSITION_BUFFER_SIZE);
+  memset(s2, 'x', POSITION_BUFFER_SIZE);
+  s2[pos] = 'y';
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += strncmp(s1, s2, POSITION_BUFFER_SIZE);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(pos + 1));
+  delete[] s1;
+  delete[] s2;
+}
+BENCHMARK(BM_string_strncmp_mismatch)->AT_POSITIONS;
+
+static void BM_string_memchr_position(int iters, int pos) {
+  StopBenchmarkTiming();
+  char* s = new char[POSITION_BUFFER_SIZE];
+  memset(s, 'x', POSITION_BUFFER_SIZE);
+  s[pos] = 'y';
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += (memchr(s, 'y', POSITION_BUFFER_SIZE) != NULL);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(pos + 1));
+  delete[] s;
+}
+BENCHMARK(BM_string_memchr_position)->AT_POSITIONS;
+
+static void BM_string_strchr_position(int iters, int pos) {
+  StopBenchmarkTiming();
+  char* s = new char[POSITION_BUFFER_SIZE];
+  memset(s, 'x', POSITION_BUFFER_SIZE);
+  s[POSITION_BUFFER_SIZE - 1] = 0;
+  s[pos] = 'y';
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += (strchr(s, 'y') != NULL);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(pos + 1));
+  delete[] s;
+}
+BENCHMARK(BM_string_strchr_position)->AT_POSITIONS;
+
+// Random-size mixes: each iteration makes SizeMix::kCalls calls.
+
+static void BM_string_memcpy_mix(int iters, int max_size) {
+  StopBenchmarkTiming();
+  SizeMix* mix = new SizeMix(max_size);
+  Buffer src(max_size + 64, 0);
+  Buffer dst(max_size + 64, 0);
+  memset(src.get(), 'x', max_size + 64);
+  StartBenchmarkTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    for (int j = 0; j < SizeMix::kCalls; ++j) {
+      memcpy(dst.get() + mix->dst_offsets[j], src.get() + mix->src_offsets[j], mix->sizes[j]);
+    }
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * mix->total_bytes);
+  delete mix;
+}
+BENCHMARK(BM_string_memcpy_mix)->AT_MIX_SIZES;
+
+static void BM_string_memset_mix(int iters, int max_size) {
+  StopBenchmarkTiming();
+  SizeMix* mix = new SizeMix(max_size);
+  Buffer dst(max_size + 64, 0);
+  StartBenchmarkTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    for (int j = 0; j < SizeMix::kCalls; ++j) {
+      memset(dst.get() + mix->dst_offsets[j], 0, mix->sizes[j]);
+    }
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * mix->total_bytes);
+  delete mix;
+}
+BENCHMARK(BM_string_memset_mix)->AT_MIX_SIZES;
+
+static void BM_string_memcmp_mix(int iters, int max_size) {
+  StopBenchmarkTiming();
+  SizeMix* mix = new SizeMix(max_size);
+  Buffer src(max_size + 64, 0);
+  Buffer dst(max_size + 64, 0);
+  memset(src.get(), 'x', max_size + 64);
+  memset(dst.get(), 'x', max_size + 64);
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    for (int j = 0; j < SizeMix::kCalls; ++j) {
+      c += memcmp(dst.get() + mix->dst_offsets[j], src.get() + mix->src_offsets[j], mix->sizes[j]);
+    }
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * mix->total_bytes);
+  delete mix;
+}
+BENCHMARK(BM_string_memcmp_mix)->AT_MIX_SIZES;
+
+static void BM_string_strlen_mix(int iters, int max_size) {
+  StopBenchmarkTiming();
+  SizeMix* mix = new SizeMix(max_size);
+  // Lay the strings out back to back, each at its own random alignment.
+  size_t* offsets = new size_t[SizeMix::kCalls];
+  Buffer s(mix->total_bytes + SizeMix::kCalls * 64, 0);
+  size_t offset = 0;
+  for (int j = 0; j < SizeMix::kCalls; ++j) {
+    offset += mix->src_offsets[j];
+    offsets[j] = offset;
+    memset(s.get() + offset, 'x', mix->sizes[j] - 1);
+    s.get()[offset + mix->sizes[j] - 1] = 0;
+    offset += mix->sizes[j];
+  }
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    for (int j = 0; j < SizeMix::kCalls; ++j) {
+      c += strlen(s.get() + offsets[j]);
+    }
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * mix->total_bytes);
+  delete[] offsets;
+  delete mix;
+}
+BENCHMARK(BM_string_strlen_mix)->AT_MIX_SIZES;
+
+// Cold-cache variants: each call works on memory that hasn't been touched
+// since the previous pass over COLD_CACHE_SIZE bytes.
+
+static void BM_string_memcpy_cold(int iters, int nbytes) {
+  StopBenchmarkTiming();
+  Buffer src(COLD_CACHE_SIZE, 0);
+  Buffer dst(COLD_CACHE_SIZE, 0);
+  memset(src.get(), 'x', COLD_CACHE_SIZE);
+  memset(dst.get(), 'x', COLD_CACHE_SIZE);
+  StartBenchmarkTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    size_t offset = ColdOffset(i, nbytes);
+    memcpy(dst.get() + offset, src.get() + offset, nbytes);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+}
+BENCHMARK(BM_string_memcpy_cold)->AT_COMMON_SIZES;
+
+static void BM_string_memset_cold(int iters, int nbytes) {
+  StopBenchmarkTiming();
+  Buffer dst(COLD_CACHE_SIZE, 0);
+  memset(dst.get(), 'x', COLD_CACHE_SIZE);
+  StartBenchmarkTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    memset(dst.get() + ColdOffset(i, nbytes), 0, nbytes);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+}
+BENCHMARK(BM_string_memset_cold)->AT_COMMON_SIZES;
+
+static void BM_string_memcmp_cold(int iters, int nbytes) {
+  StopBenchmarkTiming();
+  Buffer src(COLD_CACHE_SIZE, 0);
+  Buffer dst(COLD_CACHE_SIZE, 0);
+  memset(src.get(), 'x', COLD_CACHE_SIZE);
+  memset(dst.get(), 'x', COLD_CACHE_SIZE);
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    size_t offset = ColdOffset(i, nbytes);
+    c += memcmp(dst.get() + offset, src.get() + offset, nbytes);
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+}
+BENCHMARK(BM_string_memcmp_cold)->AT_COMMON_SIZES;
+
+static void BM_string_strlen_cold(int iters, int nbytes) {
+  StopBenchmarkTiming();
+  Buffer s(COLD_CACHE_SIZE, 0);
+  memset(s.get(), 'x', COLD_CACHE_SIZE);
+  // Terminate the string in every slot ColdOffset will hand out.
+  for (int i = 0; i == 0 || ColdOffset(i, nbytes) != 0; ++i) {
+    s.get()[ColdOffset(i, nbytes) + nbytes - 1] = 0;
+  }
+  StartBenchmarkTiming();
+
+  volatile int c __attribute__((unused)) = 0;
+  for (int i = 0; i < iters; ++i) {
+    c += strlen(s.get() + ColdOffset(i, nbytes));
+  }
+
+  StopBenchmarkTiming();
+  SetBenchmarkBytesProcessed(int64_t(iters) * int64_t(nbytes));
+}
+BENCHMARK(BM_string_strlen_cold)->AT_COMMON_SIZES;
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * IFUNC resolvers choosing between the SSE2-era string routines that libc.a
+ * uses and AVX2 versions of them, for libc.so only (static executables don't
+ * process IRELATIVE relocations).
+ *
+ * The resolvers run while the dynamic linker is relocating libc.so, before
+ * any of libc has been initialized and possibly before libc's own GOT has
+ * been filled in, so they can't call into libc (not even getauxval(3), whose
+ * AT_HWCAP doesn't describe AVX2 on x86 anyway) and may only refer to hidden
+ * symbols. They ask the CPU directly with cpuid. <string.h> isn't included,
+ * so the FORTIFY inlines can't get in the way of the declarations below.
+ */
+
+#include <stddef.h>
+#include <sys/cdefs.h>
+
+static int avx2_state = -1;
+
+static void cpuid(unsigned leaf, unsigned subleaf,
+                  unsigned* eax, unsigned* ebx, unsigned* ecx, unsigned* edx) {
+  __asm__ volatile("cpuid"
+                   : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                   : "a"(leaf), "c"(subleaf));
+}
+
+/*
+ * AVX2 is only usable if the CPU has it and the kernel saves the ymm
+ * registers on context switch (OSXSAVE, with XCR0 covering SSE and AVX
+ * state).
+ */
+static int cpu_has_avx2(void) {
+  if (avx2_state == -1) {
+    unsigned eax, ebx, ecx, edx;
+    int result = 0;
+    cpuid(0, 0, &eax, &ebx, &ecx, &edx);
+    if (eax >= 7) {
+      cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+      const unsigned osxsave_and_avx = (1u << 27) | (1u << 28);
+      if ((ecx & osxsave_and_avx) == osxsave_and_avx) {
+        unsigned xcr0_lo, xcr0_hi;
+        __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+        if ((xcr0_lo & 6) == 6) {
+          cpuid(7, 0, &eax, &ebx, &ecx, &edx);
+          result = (ebx & (1u << 5)) != 0;
+        }
+      }
+    }
+    avx2_state = result;
+  }
+  return avx2_state;
+}
+
+#define DEFINE_IFUNC(name, ret, args, avx2_impl, default_impl) \
+  typedef ret name##_func args; \
+  __LIBC_HIDDEN__ extern name##_func avx2_impl, default_impl; \
+  static name##_func* name##_resolver(void) { \
+    return cpu_has_avx2() ? avx2_impl : default_impl; \
+  } \
+  ret name args __attribute__((ifunc(#name "_resolver")))
+
+DEFINE_IFUNC(memchr, void*, (const void*, int, size_t), __memchr_avx2, __memchr_sse2);
+DEFINE_IFUNC(memcmp, int, (const void*, const void*, size_t), __memcmp_avx2, __memcmp_sse4);
+DEFINE_IFUNC(memcpy, void*, (void*, const void*, size_t), __memcpy_avx2, __memcpy_sse2);
+DEFINE_IFUNC(memmove, void*, (void*, const void*, size_t), __memmove_avx2, __memmove_sse2);
+DEFINE_IFUNC(memset, void*, (void*, int, size_t), __memset_avx2, __memset_sse2);
+DEFINE_IFUNC(strcmp, int, (const char*, const char*), __strcmp_avx2, __strcmp_ssse3);
+DEFINE_IFUNC(strlen, size_t, (const char*), __strlen_avx2, __strlen_sse2);
@@ -9,20 +9,11 @@ libc_bionic_src_files_x86_64 += \
     bionic/__memset_chk.cpp \
     bionic/__strcpy_chk.cpp \
     bionic/__strcat_chk.cpp \
-    bionic/memchr.c \
-    bionic/memrchr.c \
-    bionic/strchr.cpp \
-    bionic/strnlen.c \
-    bionic/strrchr.cpp \
 
 libc_freebsd_src_files_x86_64 += \
     upstream-freebsd/lib/libc/string/wcscat.c \
-    upstream-freebsd/lib/libc/string/wcschr.c \
     upstream-freebsd/lib/libc/string/wcscmp.c \
     upstream-freebsd/lib/libc/string/wcscpy.c \
-    upstream-freebsd/lib/libc/string/wcslen.c \
-    upstream-freebsd/lib/libc/string/wcsrchr.c \
-    upstream-freebsd/lib/libc/string/wmemcmp.c \
     upstream-freebsd/lib/libc/string/wmemmove.c \
 
 libc_openbsd_src_files_x86_64 += \
@@ -49,19 +40,50 @@ libc_bionic_src_files_x86_64 += \
 #
 
 libc_bionic_src_files_x86_64 += \
-    arch-x86_64/string/sse2-memcpy-slm.S \
-    arch-x86_64/string/sse2-memmove-slm.S \
-    arch-x86_64/string/sse2-memset-slm.S \
+    arch-x86_64/string/sse2-memrchr.S \
     arch-x86_64/string/sse2-stpcpy-slm.S \
     arch-x86_64/string/sse2-stpncpy-slm.S \
     arch-x86_64/string/sse2-strcat-slm.S \
+    arch-x86_64/string/sse2-strchr.S \
     arch-x86_64/string/sse2-strcpy-slm.S \
-    arch-x86_64/string/sse2-strlen-slm.S \
     arch-x86_64/string/sse2-strncat-slm.S \
     arch-x86_64/string/sse2-strncpy-slm.S \
+    arch-x86_64/string/sse2-strnlen.S \
+    arch-x86_64/string/sse2-strrchr.S \
+    arch-x86_64/string/sse2-wcschr.S \
+    arch-x86_64/string/sse2-wcslen.S \
+    arch-x86_64/string/sse2-wcsrchr.S \
+    arch-x86_64/string/sse4-wmemcmp-slm.S \
+    arch-x86_64/string/ssse3-strncmp-slm.S \
+
+# libc.so picks between these and AVX2 versions at load time with IFUNCs
+# (see arch-x86_64/string/ifunc.c). Static executables don't process IRELATIVE
+# relocations, so libc.a and the linker call the baseline versions directly.
+libc_arch_static_src_files_x86_64 := \
+    arch-x86_64/string/sse2-memchr.S \
+    arch-x86_64/string/sse2-memcpy-slm.S \
+    arch-x86_64/string/sse2-memmove-slm.S \
+    arch-x86_64/string/sse2-memset-slm.S \
+    arch-x86_64/string/sse2-strlen-slm.S \
     arch-x86_64/string/sse4-memcmp-slm.S \
     arch-x86_64/string/ssse3-strcmp-slm.S \
-    arch-x86_64/string/ssse3-strncmp-slm.S \
+
+libc_arch_dynamic_src_files_x86_64 := \
+    arch-x86_64/string/avx2-memchr.S \
+    arch-x86_64/string/avx2-memcmp.S \
+    arch-x86_64/string/avx2-memcpy.S \
+    arch-x86_64/string/avx2-memmove.S \
+    arch-x86_64/string/avx2-memset.S \
+    arch-x86_64/string/avx2-strcmp.S \
+    arch-x86_64/string/avx2-strlen.S \
+    arch-x86_64/string/ifunc-sse2-memchr.S \
+    arch-x86_64/string/ifunc-sse2-memcpy-slm.S \
+    arch-x86_64/string/ifunc-sse2-memmove-slm.S \
+    arch-x86_64/string/ifunc-sse2-memset-slm.S \
+    arch-x86_64/string/ifunc-sse2-strlen-slm.S \
+    arch-x86_64/string/ifunc-sse4-memcmp-slm.S \
+    arch-x86_64/string/ifunc-ssse3-strcmp-slm.S \
+    arch-x86_64/string/ifunc.c \
 
 libc_crt_target_cflags_x86_64 += \
     -m64 \
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/cdefs.h>
+#include <unistd.h>
+
+#include "private/ScopedFd.h"
+
+// memcpy, memmove and memset switch to non-temporal stores once a call
+// touches more memory than the last-level cache can hold, so that one huge
+// copy doesn't evict everything else. The defaults below are what the
+// assembler used to hard-code; they stay in effect until
+// __libc_init_cache_info runs, and in the dynamic linker, which never calls it.
+// A copy touches twice as many bytes as it writes, so it uses half the size.
+
+#if defined(__x86_64__) || defined(__aarch64__)
+
+// A last-level cache smaller than this is much more likely to be misreported
+// than real, and streaming anything smaller would slow down ordinary copies.
+#define MIN_LAST_LEVEL_CACHE_SIZE (256 * 1024)
+
+// Returns the size to use given a detected size, which is 0 if detection failed.
+static size_t sane_cache_size(size_t size, size_t default_size) {
+  if (size == 0) {
+    return default_size;
+  }
+  return (size < MIN_LAST_LEVEL_CACHE_SIZE) ? MIN_LAST_LEVEL_CACHE_SIZE : size;
+}
+
+#endif
+
+#if defined(__x86_64__)
+
+__LIBC_HIDDEN__ size_t __x86_64_shared_cache_size = 1024 * 1024;
+__LIBC_HIDDEN__ size_t __x86_64_shared_cache_size_half = 1024 * 1024 / 2;
+
+static void cpuid(unsigned leaf, unsigned subleaf,
+                  unsigned* eax, unsigned* ebx, unsigned* ecx, unsigned* edx) {
+  __asm__ volatile("cpuid"
+                   : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                   : "a"(leaf), "c"(subleaf));
+}
+
+// Intel's leaf 4 and AMD's leaf 0x8000001d describe one cache per subleaf in
+// the same format. Returns the size of the highest-level data or unified cache.
+static size_t deterministic_cache_size(unsigned leaf) {
+  size_t result = 0;
+  unsigned result_level = 0;
+  for (unsigned i = 0; i < 16; ++i) {
+    unsigned eax, ebx, ecx, edx;
+    cpuid(leaf, i, &eax, &ebx, &ecx, &edx);
+    unsigned type = eax & 0x1f;
+    if (type == 0) {
+      break;
+    }
+    unsigned level = (eax >> 5) & 0x7;
+    if (type == 2 || level < result_level) {
+      continue;  // Instruction cache, or not the last level.
+    }
+    size_t ways = (ebx >> 22) + 1;
+    size_t partitions = ((ebx >> 12) & 0x3ff) + 1;
+    size_t line_size = (ebx & 0xfff) + 1;
+    size_t sets = static_cast<size_t>(ecx) + 1;
+    result = ways * partitions * line_size * sets;
+    result_level = level;
+  }
+  return result;
+}
+
+static size_t last_level_cache_size() {
+  unsigned max_leaf, vendor_b, vendor_c, vendor_d;
+  cpuid(0, 0, &max_leaf, &vendor_b, &vendor_c, &vendor_d);
+  // "GenuineIntel" is spread across ebx, edx and ecx.
+  if (vendor_b == 0x756e6547 && vendor_d == 0x49656e69 && vendor_c == 0x6c65746e) {
+    return (max_leaf >= 4) ? deterministic_cache_size(4) : 0;
+  }
+
+  unsigned max_extended_leaf, ebx, ecx, edx;
+  cpuid(0x80000000, 0, &max_extended_leaf, &ebx, &ecx, &edx);
+  if (max_extended_leaf >= 0x8000001d) {
+    unsigned eax;
+    cpuid(0x80000001, 0, &eax, &ebx, &ecx, &edx);
+    if ((ecx & (1u << 22)) != 0) {  // TopologyExtensions.
+      return deterministic_cache_size(0x8000001d);
+    }
+  }
+  if (max_extended_leaf >= 0x80000006) {
+    unsigned eax;
+    cpuid(0x80000006, 0, &eax, &ebx, &ecx, &edx);
+    // edx[31:18] is the L3 size in 512KiB units, ecx[31:16] the L2 size in KiB.
+    size_t l3 = static_cast<size_t>(edx >> 18) * 512 * 1024;
+    return (l3 != 0) ? l3 : static_cast<size_t>(ecx >> 16) * 1024;
+  }
+  return 0;
+}
+
+void __libc_init_cache_info() {
+  size_t size = sane_cache_size(last_level_cache_size(), __x86_64_shared_cache_size);
+  __x86_64_shared_cache_size = size;
+  __x86_64_shared_cache_size_half = size / 2;
+}
+
+#elif defined(__aarch64__)
+
+// The cache ID registers aren't readable from EL0, so ask the kernel. Kernels
+// that don't export the cache topology leave us with a default that's bigger
+// than any current last-level cache, so copies that used to stay cached still
+// do.
+#define DEFAULT_LAST_LEVEL_CACHE_SIZE (4 * 1024 * 1024)
+
+__LIBC_HIDDEN__ size_t __arm64_shared_cache_size = DEFAULT_LAST_LEVEL_CACHE_SIZE;
+__LIBC_HIDDEN__ size_t __arm64_shared_cache_size_half = DEFAULT_LAST_LEVEL_CACHE_SIZE / 2;
+
+static bool read_cache_attribute(unsigned index, const char* attribute, char* buf, size_t buf_size) {
+  char path[80];
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%u/%s", index, attribute);
+  ScopedFd fd(TEMP_FAILURE_RETRY(open(path, O_RDONLY | O_CLOEXEC)));
+  if (fd.get() == -1) {
+    return false;
+  }
+  ssize_t n = TEMP_FAILURE_RETRY(read(fd.get(), buf, buf_size - 1));
+  if (n <= 0) {
+    return false;
+  }
+  buf[n] = '\0';
+  return true;
+}
+
+// The highest-numbered cache level's "size", such as "2048K".
+static size_t last_level_cache_size() {
+  char buf[32];
+  unsigned long best_level = 0;
+  unsigned best_index = 0;
+  for (unsigned i = 0; read_cache_attribute(i, "level", buf, sizeof(buf)); ++i) {
+    unsigned long level = strtoul(buf, NULL, 10);
+    if (level > best_level) {
+      best_level = level;
+      best_index = i;
+    }
+  }
+  if (best_level == 0 || !read_cache_attribute(best_index, "size", buf, sizeof(buf))) {
+    return 0;
+  }
+
+  char* end;
+  size_t size = strtoul(buf, &end, 10);
+  if (*end == 'K') {
+    size *= 1024;
+  } else if (*end == 'M') {
+    size *= 1024 * 1024;
+  }
+  return size;
+}
+
+// Reading sysfs takes an open and a read per cache (a dozen or so system
+// calls in all). Failing ones are expected, on kernels without the cache
+// topology or past the last cache, so don't let them show up in errno.
+void __libc_init_cache_info() {
+  int saved_errno = errno;
+  size_t size = sane_cache_size(last_level_cache_size(), __arm64_shared_cache_size);
+  __arm64_shared_cache_size = size;
+  __arm64_shared_cache_size_half = size / 2;
+  errno = saved_errno;
+}
+
+#else
+
+void __libc_init_cache_info() {
+}
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef DEBUG_FRAME_POINTER_H
+#define DEBUG_FRAME_POINTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// On these architectures a frame record is the caller's frame pointer followed
+// by the return address. (On arm the layout depends on the compiler and on
+// ARM vs Thumb code, and mips code has no frame records at all.)
+#if defined(__aarch64__) || defined(__i386__) || defined(__x86_64__)
+#define HAVE_FRAME_POINTER_BACKTRACE 1
+
+// Collects return addresses by following the chain of frame records from 'fp',
+// a __builtin_frame_address. This is much cheaper than unwinding with the
+// unwind tables, but only sees code built with frame pointers: a function
+// without one ends the walk. Records must lie within [stack_lo, stack_hi) and
+// each must be above the last, so a bad chain stops the walk rather than
+// faulting.
+static inline size_t frame_pointer_backtrace(uintptr_t fp, uintptr_t stack_lo, uintptr_t stack_hi,
+                                             uintptr_t* frames, size_t max_depth) {
+  size_t frame_count = 0;
+  while (frame_count < max_depth) {
+    if (fp < stack_lo || fp > stack_hi - 2 * sizeof(uintptr_t) ||
+        (fp & (sizeof(uintptr_t) - 1)) != 0) {
+      break;
+    }
+    const uintptr_t* record = reinterpret_cast<const uintptr_t*>(fp);
+    uintptr_t next_fp = record[0];
+    uintptr_t return_address = record[1];
+    if (return_address == 0) {
+      break;
+    }
+    frames[frame_count++] = return_address;
+    if (next_fp <= fp) {
+      break;
+    }
+    fp = next_fp;
+  }
+  return frame_count;
+}
+
+// As frame_pointer_backtrace, but if there's no usable frame record at 'fp'
+// (because we're on an alternate signal stack, say, or the chain is corrupt)
+// returns what 'fallback' collects instead.
+static inline size_t frame_pointer_backtrace_or(size_t (*fallback)(uintptr_t*, size_t),
+                                                uintptr_t fp, uintptr_t stack_lo, uintptr_t stack_hi,
+                                                uintptr_t* frames, size_t max_depth) {
+  size_t frame_count = frame_pointer_backtrace(fp, stack_lo, stack_hi, frames, max_depth);
+  return (frame_count != 0) ? frame_count : fallback(frames, max_depth);
+}
+#endif
+
+#endif /* DEBUG_FRAME_POINTER_H */
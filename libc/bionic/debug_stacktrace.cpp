@@ -30,10 +30,15 @@
 
 #include <dlfcn.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <unwind.h>
+#include <sys/system_properties.h>
 #include <sys/types.h>
 
+#include "debug_frame_pointer.h"
 #include "debug_mapinfo.h"
 #include "malloc_debug_disable.h"
 #include "private/libc_logging.h"
@@ -56,9 +61,69 @@ static void* g_demangler;
 typedef char* (*DemanglerFn)(const char*, char*, size_t*, int*);
 static DemanglerFn g_demangler_fn = NULL;
 
+#if defined(HAVE_FRAME_POINTER_BACKTRACE)
+// Set by libc.debug.malloc.backtrace=fp.
+static bool g_use_frame_pointers = false;
+
+// Each thread's stack, so we know which frame records to trust.
+struct stack_bounds_t {
+  uintptr_t lo;
+  uintptr_t hi;
+};
+
+static pthread_key_t g_stack_bounds_key;
+
+static void stack_bounds_destroy(void* bounds) {
+  ScopedDisableDebugCalls disable;
+  free(bounds);
+}
+
+static stack_bounds_t* get_stack_bounds() {
+  stack_bounds_t* bounds = reinterpret_cast<stack_bounds_t*>(pthread_getspecific(g_stack_bounds_key));
+  if (bounds == NULL) {
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) != 0) {
+      return NULL;
+    }
+    void* stack_base;
+    size_t stack_size;
+    int result = pthread_attr_getstack(&attr, &stack_base, &stack_size);
+    pthread_attr_destroy(&attr);
+    if (result != 0) {
+      return NULL;
+    }
+
+    bounds = reinterpret_cast<stack_bounds_t*>(malloc(sizeof(stack_bounds_t)));
+    if (bounds == NULL) {
+      return NULL;
+    }
+    bounds->lo = reinterpret_cast<uintptr_t>(stack_base);
+    bounds->hi = bounds->lo + stack_size;
+    pthread_setspecific(g_stack_bounds_key, bounds);
+  }
+  return bounds;
+}
+#endif
+
 __LIBC_HIDDEN__ void backtrace_startup() {
   ScopedDisableDebugCalls disable;
 
+  // Unwinding with the unwind tables works for all code, but is slow. Walking
+  // frame pointers is much faster, but misses frames in code built without
+  // them, so it's opt-in.
+  char value[PROP_VALUE_MAX];
+  if (__system_property_get("libc.debug.malloc.backtrace", value) && strcmp(value, "fp") == 0) {
+#if defined(HAVE_FRAME_POINTER_BACKTRACE)
+    if (pthread_key_create(&g_stack_bounds_key, stack_bounds_destroy) == 0) {
+      g_use_frame_pointers = true;
+      __libc_format_log(ANDROID_LOG_INFO, "libc", "using frame pointers for backtraces\n");
+    }
+#else
+    __libc_format_log(ANDROID_LOG_WARN, "libc",
+                      "frame pointer backtraces aren't supported on this architecture\n");
+#endif
+  }
+
   g_map_info = mapinfo_create(getpid());
   g_demangler = dlopen("libgccdemangle.so", RTLD_NOW);
   if (g_demangler != NULL) {
@@ -85,10 +150,10 @@ struct stack_crawl_state_t {
   uintptr_t* frames;
   size_t frame_count;
   size_t max_depth;
-  bool have_skipped_self;
+  size_t frames_to_skip;
 
   stack_crawl_state_t(uintptr_t* frames, size_t max_depth)
-      : frames(frames), frame_count(0), max_depth(max_depth), have_skipped_self(false) {
+      : frames(frames), frame_count(0), max_depth(max_depth), frames_to_skip(2) {
   }
 };
 
@@ -97,9 +162,9 @@ static _Unwind_Reason_Code trace_function(__unwind_context* context, void* arg)
 
   uintptr_t ip = _Unwind_GetIP(context);
 
-  // The first stack frame is get_backtrace itself. Skip it.
-  if (ip != 0 && !state->have_skipped_self) {
-    state->have_skipped_self = true;
+  // The first two stack frames are unwind_backtrace and get_backtrace. Skip them.
+  if (ip != 0 && state->frames_to_skip > 0) {
+    --state->frames_to_skip;
     return _URC_NO_REASON;
   }
 
@@ -125,14 +190,32 @@ static _Unwind_Reason_Code trace_function(__unwind_context* context, void* arg)
   return (state->frame_count >= state->max_depth) ? _URC_END_OF_STACK : _URC_NO_REASON;
 }
 
-__LIBC_HIDDEN__ int get_backtrace(uintptr_t* frames, size_t max_depth) {
-  ScopedDisableDebugCalls disable;
-
+// Not inlined, so that it's always exactly one frame below get_backtrace.
+__attribute__((noinline)) static size_t unwind_backtrace(uintptr_t* frames, size_t max_depth) {
   stack_crawl_state_t state(frames, max_depth);
   _Unwind_Backtrace(trace_function, &state);
   return state.frame_count;
 }
 
+__LIBC_HIDDEN__ int get_backtrace(uintptr_t* frames, size_t max_depth) {
+  ScopedDisableDebugCalls disable;
+
+#if defined(HAVE_FRAME_POINTER_BACKTRACE)
+  if (g_use_frame_pointers) {
+    // Our own frame record holds the return address into our caller, which is
+    // where the unwinder's backtrace starts too.
+    stack_bounds_t* bounds = get_stack_bounds();
+    if (bounds != NULL) {
+      return frame_pointer_backtrace_or(unwind_backtrace,
+                                        reinterpret_cast<uintptr_t>(__builtin_frame_address(0)),
+                                        bounds->lo, bounds->hi, frames, max_depth);
+    }
+  }
+#endif
+
+  return unwind_backtrace(frames, max_depth);
+}
+
 __LIBC_HIDDEN__ void log_backtrace(uintptr_t* frames, size_t frame_count) {
   ScopedDisableDebugCalls disable;
 
@@ -31,9 +31,407 @@ static void* named_anonymous_mmap(size_t length);
 #define MMAP(s) named_anonymous_mmap(s)
 #define DIRECT_MMAP(s) named_anonymous_mmap(s)
 
+// The per-thread caches below provide malloc, calloc and free, so dlmalloc's
+// own versions of those become the global heap behind the caches.
+#if defined(__LP64__)
+#define dlmalloc dlmalloc_global
+#else
+#define dlmalloc_real dlmalloc_global // dlmalloc.h has already renamed dlmalloc.
+#endif
+#define dlcalloc dlcalloc_global
+#define dlfree dlfree_global
+#define dlmalloc_trim dlmalloc_trim_top
+
 // Ugly inclusion of C file so that bionic specific #defines configure dlmalloc.
 #include "../upstream-dlmalloc/malloc.c"
 
+#if defined(__LP64__)
+#undef dlmalloc
+#else
+#undef dlmalloc_real
+#endif
+#undef dlcalloc
+#undef dlfree
+#undef dlmalloc_trim
+
+// dlmalloc serializes everything on one global lock. To keep threads from
+// fighting over it, each thread keeps a few free chunks of each small size
+// (one LIFO list per dlmalloc small bin), takes them from the global heap a
+// batch at a time with dlindependent_comalloc, and gives them back a batch at
+// a time with dlbulk_free. As far as dlmalloc is concerned, chunks in a cache
+// are still in use, so malloc_usable_size works on them unchanged and they're
+// counted as allocated by mallinfo and dlmalloc_inspect_all.
+//
+// Each cache has its own lock, which only its thread takes except during
+// malloc_disable and fork, so it's almost never contended. The lock order is
+// thread_cache_list_lock, then a cache's lock, then the global heap's lock.
+//
+// A chunk's head word belongs to the global heap, which rewrites it under its
+// lock when a neighboring chunk changes, so cached chunks are marked in their
+// payload instead: the word after the free list link holds the chunk's address
+// xored with dlmalloc's random magic number. That lets dlfree catch double
+// frees of cached chunks and lets dlmalloc_iterate leave them out.
+#define THREAD_CACHE_MAX_COUNT 64U
+#define THREAD_CACHE_MAX_BIN_BYTES 4096U
+
+#define thread_cache_cookie(mem) ((size_t) (mem) ^ mparams.magic)
+#define is_thread_cached(mem) (((size_t*) (mem))[1] == thread_cache_cookie(mem))
+#define set_thread_cached(mem) (((size_t*) (mem))[1] = thread_cache_cookie(mem))
+#define clear_thread_cached(mem) (((size_t*) (mem))[1] = 0)
+
+struct thread_cache_bin {
+  void* head;
+  unsigned int count;
+  unsigned int limit;
+};
+
+struct thread_cache {
+  pthread_mutex_t lock;
+  struct thread_cache* next;
+  struct thread_cache* prev;
+  struct thread_cache_bin bins[NSMALLBINS];
+};
+
+static pthread_key_t thread_cache_key = -1;
+
+// Every thread's cache, so malloc_disable can lock them all.
+static pthread_mutex_t thread_cache_list_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct thread_cache* thread_caches = NULL;
+
+// Gives all but the first 'keep' chunks in the bin back to the global heap.
+static void thread_cache_flush_bin(struct thread_cache_bin* bin, unsigned int keep) {
+  void* chunks[THREAD_CACHE_MAX_COUNT];
+  size_t n = 0;
+  void** link = &bin->head;
+  unsigned int i;
+  for (i = 0; i < keep && *link != NULL; ++i) {
+    link = (void**) *link;
+  }
+  void* mem = *link;
+  *link = NULL;
+  while (mem != NULL) {
+    chunks[n++] = mem;
+    mem = *(void**) mem;
+  }
+  bin->count -= n;
+  for (i = 0; i < n; ++i) {
+    clear_thread_cached(chunks[i]);
+  }
+  if (n != 0) {
+    dlbulk_free(chunks, n);
+  }
+}
+
+// Takes half a bin's worth of chunks of size 'nb' from the global heap.
+static void thread_cache_refill_bin(struct thread_cache_bin* bin, size_t nb) {
+  size_t sizes[THREAD_CACHE_MAX_COUNT / 2];
+  void* chunks[THREAD_CACHE_MAX_COUNT / 2];
+  size_t n = bin->limit / 2;
+  size_t i;
+  for (i = 0; i < n; ++i) {
+    sizes[i] = nb - CHUNK_OVERHEAD;
+  }
+  if (dlindependent_comalloc(n, sizes, chunks) == NULL) {
+    return;
+  }
+  // The chunks are contiguous; hand them out in address order.
+  for (i = n; i-- > 0; ) {
+    set_thread_cached(chunks[i]);
+    *(void**) chunks[i] = bin->head;
+    bin->head = chunks[i];
+  }
+  bin->count += n;
+}
+
+static void thread_cache_destroy(void* arg) {
+  struct thread_cache* tc = (struct thread_cache*) arg;
+  size_t i;
+  pthread_mutex_lock(&tc->lock);
+  for (i = 0; i < NSMALLBINS; ++i) {
+    thread_cache_flush_bin(&tc->bins[i], 0);
+  }
+  pthread_mutex_unlock(&tc->lock);
+
+  pthread_mutex_lock(&thread_cache_list_lock);
+  if (tc->prev != NULL) {
+    tc->prev->next = tc->next;
+  } else {
+    thread_caches = tc->next;
+  }
+  if (tc->next != NULL) {
+    tc->next->prev = tc->prev;
+  }
+  pthread_mutex_unlock(&thread_cache_list_lock);
+  dlfree_global(tc);
+}
+
+// Only the forking thread exists in the child, so only its cache is kept; the
+// chunks in the others leak, as they would if those threads never exited.
+static void thread_cache_post_fork_child(void) {
+  INITIAL_LOCK(&gm->mutex);
+  struct thread_cache* tc = (struct thread_cache*) pthread_getspecific(thread_cache_key);
+  if (tc != NULL) {
+    pthread_mutex_init(&tc->lock, NULL);
+    tc->next = NULL;
+    tc->prev = NULL;
+  }
+  thread_caches = tc;
+  pthread_mutex_init(&thread_cache_list_lock, NULL);
+}
+
+__attribute__((constructor)) static void thread_cache_init(void) {
+  pthread_key_create(&thread_cache_key, thread_cache_destroy);
+  pthread_atfork(dlmalloc_disable, dlmalloc_enable, thread_cache_post_fork_child);
+}
+
+static struct thread_cache* thread_cache_get(void) {
+  struct thread_cache* tc = (struct thread_cache*) pthread_getspecific(thread_cache_key);
+  if (__predict_false(tc == NULL) && thread_cache_key != -1) {
+    tc = (struct thread_cache*) dlcalloc_global(1, sizeof(struct thread_cache));
+    if (tc == NULL) {
+      return NULL;
+    }
+    pthread_mutex_init(&tc->lock, NULL);
+    size_t i;
+    for (i = small_index(MIN_CHUNK_SIZE); i < NSMALLBINS; ++i) {
+      size_t limit = THREAD_CACHE_MAX_BIN_BYTES / small_index2size(i);
+      tc->bins[i].limit = (limit < THREAD_CACHE_MAX_COUNT) ? limit : THREAD_CACHE_MAX_COUNT;
+    }
+    pthread_mutex_lock(&thread_cache_list_lock);
+    tc->next = thread_caches;
+    if (thread_caches != NULL) {
+      thread_caches->prev = tc;
+    }
+    thread_caches = tc;
+    pthread_mutex_unlock(&thread_cache_list_lock);
+    pthread_setspecific(thread_cache_key, tc);
+  }
+  return tc;
+}
+
+// Returns a chunk of size 'nb' from this thread's cache, or NULL.
+static void* thread_cache_malloc(size_t nb) {
+  struct thread_cache* tc = thread_cache_get();
+  if (tc == NULL) {
+    return NULL;
+  }
+  pthread_mutex_lock(&tc->lock);
+  struct thread_cache_bin* bin = &tc->bins[small_index(nb)];
+  if (bin->head == NULL) {
+    thread_cache_refill_bin(bin, nb);
+  }
+  void* mem = bin->head;
+  if (mem != NULL) {
+    bin->head = *(void**) mem;
+    --bin->count;
+    clear_thread_cached(mem);
+  }
+  pthread_mutex_unlock(&tc->lock);
+  return mem;
+}
+
+void* dlmalloc(size_t bytes) {
+  if (bytes <= MAX_SMALL_REQUEST) {
+    void* mem = thread_cache_malloc(request2size(bytes));
+    if (mem != NULL) {
+      return mem;
+    }
+  }
+  return dlmalloc_global(bytes);
+}
+
+void* dlcalloc(size_t n_elements, size_t elem_size) {
+  if (n_elements != 0 && elem_size <= MAX_SMALL_REQUEST / n_elements) {
+    size_t bytes = n_elements * elem_size;
+    void* mem = thread_cache_malloc(request2size(bytes));
+    if (mem != NULL) {
+      memset(mem, 0, bytes);
+      return mem;
+    }
+  }
+  return dlcalloc_global(n_elements, elem_size);
+}
+
+void dlfree(void* mem) {
+  if (mem == NULL) {
+    return;
+  }
+  mchunkptr p = mem2chunk(mem);
+  size_t size = chunksize(p);
+  if (is_small(size) && !is_mmapped(p)) {
+    // dlfree would catch the first two, and no cache may hand out a chunk that's
+    // already in one (this thread's or another's).
+    if (!RTCHECK(ok_address(gm, p) && ok_inuse(p)) || is_thread_cached(mem)) {
+      USAGE_ERROR_ACTION(gm, mem);
+      return;
+    }
+    struct thread_cache* tc = (struct thread_cache*) pthread_getspecific(thread_cache_key);
+    if (tc == NULL) {
+      dlfree_global(mem);
+      return;
+    }
+    pthread_mutex_lock(&tc->lock);
+    struct thread_cache_bin* bin = &tc->bins[small_index(size)];
+    if (bin->count == bin->limit) {
+      thread_cache_flush_bin(bin, bin->limit / 2);
+    }
+    set_thread_cached(mem);
+    *(void**) mem = bin->head;
+    bin->head = mem;
+    ++bin->count;
+    pthread_mutex_unlock(&tc->lock);
+    return;
+  }
+  dlfree_global(mem);
+}
+
+// dlmalloc keeps each chunk's size in the word in front of it, and dlfree has
+// to check that word anyway, so being told the size only helps by letting
+// allocations too big for the thread caches go straight to the global heap.
+void dlfree_sized(void* mem, size_t bytes) {
+  if (bytes > MAX_SMALL_REQUEST) {
+    dlfree_global(mem);
+    return;
+  }
+  dlfree(mem);
+}
+
+void dlfree_aligned_sized(void* mem, size_t alignment __unused, size_t bytes) {
+  dlfree_sized(mem, bytes);
+}
+
+// dlmalloc only gives back free memory at the top of the heap, so a burst of
+// allocations followed by frees can leave the heap big and mostly empty for
+// good. As well as trimming the top, madvise away any whole pages inside free
+// chunks; they come back as zero pages if the chunks are reused. The calling
+// thread's cache is flushed first so its chunks can be released too.
+static void madvise_free_chunk(void* start, void* end, size_t used_bytes, void* arg) {
+  if (used_bytes != 0) {
+    return;
+  }
+  size_t pagesize = getpagesize();
+  char* page_start = (char*) (((size_t) start + pagesize - 1) & ~(pagesize - 1));
+  char* page_end = (char*) ((size_t) end & ~(pagesize - 1));
+  if (page_start < page_end) {
+    madvise(page_start, page_end - page_start, MADV_DONTNEED);
+    *(size_t*) arg += page_end - page_start;
+  }
+}
+
+int dlmalloc_trim(size_t pad) {
+  if (thread_cache_key != -1) {
+    struct thread_cache* tc = (struct thread_cache*) pthread_getspecific(thread_cache_key);
+    if (tc != NULL) {
+      size_t i;
+      pthread_mutex_lock(&tc->lock);
+      for (i = 0; i < NSMALLBINS; ++i) {
+        thread_cache_flush_bin(&tc->bins[i], 0);
+      }
+      pthread_mutex_unlock(&tc->lock);
+    }
+  }
+  int result = dlmalloc_trim_top(pad);
+  size_t released = 0;
+  dlmalloc_inspect_all(madvise_free_chunk, &released);
+  return result || released != 0;
+}
+
+// malloc_disable locks every thread's cache and then the global heap, so the
+// heap stays still while dlmalloc_iterate walks it. fork does the same, so no
+// cache is left half updated in the child.
+void dlmalloc_disable(void) {
+  pthread_mutex_lock(&thread_cache_list_lock);
+  struct thread_cache* tc;
+  for (tc = thread_caches; tc != NULL; tc = tc->next) {
+    pthread_mutex_lock(&tc->lock);
+  }
+  ACQUIRE_LOCK(&gm->mutex);
+}
+
+void dlmalloc_enable(void) {
+  RELEASE_LOCK(&gm->mutex);
+  struct thread_cache* tc;
+  for (tc = thread_caches; tc != NULL; tc = tc->next) {
+    pthread_mutex_unlock(&tc->lock);
+  }
+  pthread_mutex_unlock(&thread_cache_list_lock);
+}
+
+static void iterate_chunk(mchunkptr p, uintptr_t base, uintptr_t end,
+                          void (*callback)(uintptr_t, size_t, void*), void* arg) {
+  uintptr_t mem = (uintptr_t) chunk2mem(p);
+  if (mem >= base && mem < end) {
+    callback(mem, chunksize(p) - overhead_for(p), arg);
+  }
+}
+
+// Returns the first chunk mmap_alloc made at or after 'start', or NULL. Each is
+// alone in a mapping of whole pages, preceded by its offset into the mapping
+// (held in its prev_foot), and followed by a fencepost. Mappings next to each
+// other may have been merged, so there may be something else before it.
+static mchunkptr find_mmapped_chunk(uintptr_t start, uintptr_t end) {
+  size_t page_mask = mparams.page_size - 1;
+  uintptr_t a;
+  for (a = start + align_offset(chunk2mem(start)); a + MIN_CHUNK_SIZE + MMAP_FOOT_PAD <= end;
+       a += MALLOC_ALIGNMENT) {
+    mchunkptr p = (mchunkptr) a;
+    size_t psize = chunksize(p);
+    if (is_mmapped(p) && p->prev_foot <= a - start && ((a - p->prev_foot) & page_mask) == 0 &&
+        psize >= MIN_CHUNK_SIZE && psize <= end - a - MMAP_FOOT_PAD &&
+        ((a + psize + MMAP_FOOT_PAD) & page_mask) == 0 &&
+        chunk_plus_offset(p, psize)->head == FENCEPOST_HEAD) {
+      return p;
+    }
+  }
+  return NULL;
+}
+
+// Reports every allocation whose address is in [base, base + size), which
+// should be made up of whole "libc_malloc" mappings.
+int dlmalloc_iterate(uintptr_t base, size_t size,
+                     void (*callback)(uintptr_t, size_t, void*), void* arg) {
+  uintptr_t end = base + size;
+  if (!is_initialized(gm)) {
+    return 0;
+  }
+  msegmentptr s;
+  for (s = &gm->seg; s != 0; s = s->next) {
+    if ((uintptr_t) s->base >= end || (uintptr_t) s->base + s->size <= base) {
+      continue;
+    }
+    mchunkptr q = align_as_chunk(s->base);
+    while (segment_holds(s, q) && q->head != FENCEPOST_HEAD && q != gm->top) {
+      if (is_inuse(q) && !is_thread_cached(chunk2mem(q))) {
+        iterate_chunk(q, base, end, callback, arg);
+      }
+      q = next_chunk(q);
+    }
+  }
+  // Anything else should be mappings holding one large chunk each.
+  uintptr_t start = base;
+  while (start < end) {
+    s = segment_holding(gm, (char*) start);
+    if (s != 0) {
+      start = (uintptr_t) s->base + s->size;
+      continue;
+    }
+    uintptr_t limit = end;
+    for (s = &gm->seg; s != 0; s = s->next) {
+      if ((uintptr_t) s->base > start && (uintptr_t) s->base < limit) {
+        limit = (uintptr_t) s->base;
+      }
+    }
+    mchunkptr p = find_mmapped_chunk(start, limit);
+    if (p == NULL) {
+      start = limit;
+      continue;
+    }
+    iterate_chunk(p, base, end, callback, arg);
+    start = (uintptr_t) p + chunksize(p) + MMAP_FOOT_PAD;
+  }
+  return 0;
+}
+
 static void __bionic_heap_corruption_error(const char* function) {
   __libc_fatal("heap corruption detected by %s", function);
 }
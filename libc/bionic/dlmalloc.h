@@ -19,6 +19,7 @@
 
 #include <sys/cdefs.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /* Configure dlmalloc. */
 #define HAVE_GETPAGESIZE 1
@@ -27,7 +28,8 @@
 #define REALLOC_ZERO_BYTES_FREES 1
 #define USE_DL_PREFIX 1
 #define USE_LOCKS 1
-#define LOCK_AT_FORK 1
+/* dlmalloc.c locks the thread caches as well as the heap at fork. */
+#define LOCK_AT_FORK 0
 #define USE_RECURSIVE_LOCK 0
 #define USE_SPIN_LOCKS 0
 #define DEFAULT_MMAP_THRESHOLD (64U * 1024U)
@@ -48,6 +50,15 @@
 __BEGIN_DECLS
 int dlmalloc_trim(size_t) __LIBC_ABI_PUBLIC__;
 void dlmalloc_inspect_all(void (*handler)(void*, void*, size_t, void*), void*) __LIBC_ABI_PUBLIC__;
+
+/* Backends for free_sized and free_aligned_sized. */
+void dlfree_sized(void*, size_t);
+void dlfree_aligned_sized(void*, size_t, size_t);
+
+/* Backends for malloc_iterate, malloc_disable and malloc_enable. */
+int dlmalloc_iterate(uintptr_t, size_t, void (*)(uintptr_t, size_t, void*), void*);
+void dlmalloc_disable(void);
+void dlmalloc_enable(void);
 __END_DECLS
 
 /* Include the proper definitions. */
@@ -25,9 +25,20 @@
 __BEGIN_DECLS
 
 struct mallinfo je_mallinfo();
+int je_mallopt(int, int);
+int je_malloc_trim(size_t);
+void je_free_sized(void*, size_t);
+void je_free_aligned_sized(void*, size_t, size_t);
+int je_malloc_iterate(uintptr_t, size_t, void (*)(uintptr_t, size_t, void*), void*);
+void je_malloc_disable();
+void je_malloc_enable();
 void* je_memalign_round_up_boundary(size_t, size_t);
 void* je_pvalloc(size_t);
 
+// jemalloc's own fork handlers, which take and release all of its locks.
+void je_jemalloc_prefork();
+void je_jemalloc_postfork_parent();
+
 __END_DECLS
 
 #endif  // LIBC_BIONIC_DLMALLOC_H_
@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <errno.h>
+#include <stdio.h>
 #include <sys/param.h>
 #include <unistd.h>
 
@@ -46,3 +48,67 @@ void* je_memalign_round_up_boundary(size_t boundary, size_t size) {
   }
   return je_memalign(boundary, size);
 }
+
+// jemalloc has no equivalent of dlmalloc's trim and mmap thresholds: it
+// always uses its own mappings and purges dirty pages itself.
+int je_mallopt(int, int) {
+  return 0;
+}
+
+// jemalloc only purges an arena's dirty pages once there are enough of them,
+// so purge them all now. The calling thread's cache is flushed first so its
+// objects can be purged too.
+int je_malloc_trim(size_t) {
+  je_mallctl("thread.tcache.flush", NULL, NULL, NULL, 0);
+
+  // Purging arena number narenas purges all of them.
+  unsigned narenas;
+  size_t size = sizeof(narenas);
+  if (je_mallctl("arenas.narenas", &narenas, &size, NULL, 0) != 0) {
+    return 0;
+  }
+  char name[32];
+  snprintf(name, sizeof(name), "arena.%u.purge", narenas);
+  return je_mallctl(name, NULL, NULL, NULL, 0) == 0;
+}
+
+// This jemalloc has no way to walk its chunks from outside, so only
+// malloc_disable and malloc_enable are supported.
+int je_malloc_iterate(uintptr_t, size_t, void (*)(uintptr_t, size_t, void*), void*) {
+  errno = ENOTSUP;
+  return -1;
+}
+
+void je_malloc_disable() {
+  je_jemalloc_prefork();
+}
+
+void je_malloc_enable() {
+  je_jemalloc_postfork_parent();
+}
+
+// jemalloc 4 can skip looking up the size class of an allocation being freed
+// if it's told the size; older versions have to look it up anyway.
+void je_free_sized(void* mem, size_t size __unused) {
+#if JEMALLOC_VERSION_MAJOR >= 4
+  if (mem != NULL) {
+    je_sdallocx(mem, size, 0);
+  }
+#else
+  je_free(mem);
+#endif
+}
+
+void je_free_aligned_sized(void* mem, size_t alignment __unused, size_t size __unused) {
+#if JEMALLOC_VERSION_MAJOR >= 4
+  if (mem != NULL) {
+    // As in je_memalign_round_up_boundary.
+    if (!powerof2(alignment)) {
+      alignment = BIONIC_ROUND_UP_POWER_OF_2(alignment);
+    }
+    je_sdallocx(mem, size, MALLOCX_ALIGN(alignment));
+  }
+#else
+  je_free(mem);
+#endif
+}
@@ -49,6 +49,7 @@ extern "C" int __system_properties_init(void);
 extern "C" int __set_tls(void* ptr);
 extern "C" int __set_tid_address(int* tid_address);
 
+void __libc_init_cache_info();
 void __libc_init_vdso();
 
 // Not public, but well-known in the BSDs.
@@ -119,6 +120,8 @@ void __libc_init_common(KernelArgumentBlock& args) {
   __system_properties_init(); // Requires 'environ'.
 
   __libc_init_vdso();
+
+  __libc_init_cache_info();
 }
 
 /* This function will be called during normal program termination
@@ -107,18 +107,43 @@ static inline const hdr_t* const_meta(const void* user) {
     return reinterpret_cast<const hdr_t*>(user) - 1;
 }
 
-// TODO: introduce a struct for this global state.
-// There are basically two lists here, the regular list and the backlog list.
-// We should be able to remove the duplication.
-static unsigned g_allocated_block_count;
-static hdr_t* tail;
-static hdr_t* head;
-static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
-
-static unsigned backlog_num;
-static hdr_t* backlog_tail;
-static hdr_t* backlog_head;
-static pthread_mutex_t backlog_lock = PTHREAD_MUTEX_INITIALIZER;
+// Live allocations are kept on one of several lists, chosen by the address of
+// the header, so that threads allocating and freeing unrelated blocks don't
+// contend for a single lock. Each shard gets its own cache line.
+#define ALLOCATION_SHARDS 16
+
+struct allocation_shard_t {
+    pthread_mutex_t lock;
+    hdr_t* head;
+    hdr_t* tail;
+    size_t count;
+} __attribute__((aligned(64)));
+
+static allocation_shard_t g_allocation_shards[ALLOCATION_SHARDS] = {
+#define SHARD_INIT { PTHREAD_MUTEX_INITIALIZER, NULL, NULL, 0 }
+    SHARD_INIT, SHARD_INIT, SHARD_INIT, SHARD_INIT,
+    SHARD_INIT, SHARD_INIT, SHARD_INIT, SHARD_INIT,
+    SHARD_INIT, SHARD_INIT, SHARD_INIT, SHARD_INIT,
+    SHARD_INIT, SHARD_INIT, SHARD_INIT, SHARD_INIT,
+#undef SHARD_INIT
+};
+
+static inline allocation_shard_t* shard_of(hdr_t* hdr) {
+    // Headers are at least MALLOC_ALIGNMENT aligned, so mix the address
+    // before picking a shard rather than using the low bits directly.
+    uintptr_t h = reinterpret_cast<uintptr_t>(hdr);
+    h ^= h >> 17;
+    h *= 0x9e3779b1U;
+    h ^= h >> 13;
+    return &g_allocation_shards[h % ALLOCATION_SHARDS];
+}
+
+// Freed blocks are kept in a ring of the most recent g_malloc_debug_backlog
+// frees so that we can detect multiple frees and use after free. A free
+// claims the next slot with an atomic increment and swaps its block in; the
+// block it displaces is checked and really freed. No lock is involved.
+static hdr_t* volatile* g_backlog;
+static volatile size_t g_backlog_next;
 
 // This variable is set to the value of property libc.debug.malloc.backlog.
 // It determines the size of the backlog we use to detect multiple frees.
@@ -195,13 +220,14 @@ static inline int del_locked(hdr_t* hdr, hdr_t** tail, hdr_t** head) {
 }
 
 static inline void add(hdr_t* hdr, size_t size) {
-    ScopedPthreadMutexLocker locker(&lock);
     hdr->tag = ALLOCATION_TAG;
     hdr->size = size;
     init_front_guard(hdr);
     init_rear_guard(hdr);
-    ++g_allocated_block_count;
-    add_locked(hdr, &tail, &head);
+    allocation_shard_t* shard = shard_of(hdr);
+    ScopedPthreadMutexLocker locker(&shard->lock);
+    ++shard->count;
+    add_locked(hdr, &shard->tail, &shard->head);
 }
 
 static inline int del(hdr_t* hdr) {
@@ -209,12 +235,27 @@ static inline int del(hdr_t* hdr) {
         return -1;
     }
 
-    ScopedPthreadMutexLocker locker(&lock);
-    del_locked(hdr, &tail, &head);
-    --g_allocated_block_count;
+    allocation_shard_t* shard = shard_of(hdr);
+    ScopedPthreadMutexLocker locker(&shard->lock);
+    // Check again now we hold the lock, in case another thread is freeing
+    // the same block.
+    if (hdr->tag != ALLOCATION_TAG) {
+        return -1;
+    }
+    del_locked(hdr, &shard->tail, &shard->head);
+    --shard->count;
+    hdr->tag = BACKLOG_TAG;
     return 0;
 }
 
+static size_t allocated_block_count() {
+    size_t count = 0;
+    for (size_t i = 0; i < ALLOCATION_SHARDS; ++i) {
+        count += g_allocation_shards[i].count;
+    }
+    return count;
+}
+
 static inline void poison(hdr_t* hdr) {
     memset(user(hdr), FREE_POISON, hdr->size);
 }
@@ -292,45 +333,49 @@ static inline int check_allocation_locked(hdr_t* hdr, int* safe) {
     return valid;
 }
 
-static inline int del_and_check_locked(hdr_t* hdr,
-                                       hdr_t** tail, hdr_t** head, unsigned* cnt,
-                                       int* safe) {
+static inline int del_leak(hdr_t* hdr, int* safe) {
+    allocation_shard_t* shard = shard_of(hdr);
+    ScopedPthreadMutexLocker locker(&shard->lock);
     int valid = check_allocation_locked(hdr, safe);
     if (safe) {
-        (*cnt)--;
-        del_locked(hdr, tail, head);
+        --shard->count;
+        del_locked(hdr, &shard->tail, &shard->head);
     }
     return valid;
 }
 
-static inline void del_from_backlog_locked(hdr_t* hdr) {
+// Checks a block leaving the backlog for use after free.
+static inline void retire_from_backlog(hdr_t* hdr) {
     int safe;
-    del_and_check_locked(hdr,
-                         &backlog_tail, &backlog_head, &backlog_num,
-                         &safe);
+    check_allocation_locked(hdr, &safe);
     hdr->tag = 0; /* clear the tag */
 }
 
-static inline void del_from_backlog(hdr_t* hdr) {
-    ScopedPthreadMutexLocker locker(&backlog_lock);
-    del_from_backlog_locked(hdr);
-}
-
-static inline int del_leak(hdr_t* hdr, int* safe) {
-    ScopedPthreadMutexLocker locker(&lock);
-    return del_and_check_locked(hdr, &tail, &head, &g_allocated_block_count, safe);
+// Removes hdr from the backlog without freeing it. Returns false if another
+// thread has already pushed it out (and so freed it).
+static bool del_from_backlog(hdr_t* hdr) {
+    for (size_t i = 0; i < g_malloc_debug_backlog; ++i) {
+        if (g_backlog[i] == hdr && __sync_bool_compare_and_swap(&g_backlog[i], hdr, NULL)) {
+            retire_from_backlog(hdr);
+            return true;
+        }
+    }
+    return false;
 }
 
 static inline void add_to_backlog(hdr_t* hdr) {
-    ScopedPthreadMutexLocker locker(&backlog_lock);
     hdr->tag = BACKLOG_TAG;
-    backlog_num++;
-    add_locked(hdr, &backlog_tail, &backlog_head);
     poison(hdr);
-    /* If we've exceeded the maximum backlog, clear it up */
-    while (backlog_num > g_malloc_debug_backlog) {
-        hdr_t* gone = backlog_tail;
-        del_from_backlog_locked(gone);
+
+    hdr_t* gone = hdr;
+    if (g_malloc_debug_backlog > 0) {
+        size_t slot = __sync_fetch_and_add(&g_backlog_next, 1) % g_malloc_debug_backlog;
+        // Release so that the poison is visible before hdr is, and acquire
+        // so that we see the poison of the block we push out.
+        gone = __atomic_exchange_n(&g_backlog[slot], hdr, __ATOMIC_ACQ_REL);
+    }
+    if (gone != NULL) {
+        retire_from_backlog(gone);
         g_malloc_dispatch->free(gone->base);
     }
 }
@@ -479,9 +524,12 @@ extern "C" void* chk_realloc(void* ptr, size_t bytes) {
 
             /* We take the memory out of the backlog and fall through so the
              * reallocation below succeeds.  Since we didn't really free it, we
-             * can default to this behavior.
+             * can default to this behavior. If another thread got there first
+             * the memory is gone, so just make a new allocation.
              */
-            del_from_backlog(hdr);
+            if (!del_from_backlog(hdr)) {
+                return chk_malloc(bytes);
+            }
         } else {
             log_message("+++ REALLOCATION %p SIZE %d IS CORRUPTED OR NOT ALLOCATED VIA TRACKER!\n",
                        user(hdr), bytes);
@@ -494,8 +542,12 @@ extern "C" void* chk_realloc(void* ptr, size_t bytes) {
         }
     }
 
+    // On failure the original allocation is still the caller's, so it
+    // goes back on its list.
+    hdr_t* old_hdr = hdr;
     size_t size = sizeof(hdr_t) + bytes + sizeof(ftr_t);
     if (size < bytes) { // Overflow
+        add(old_hdr, old_hdr->size);
         errno = ENOMEM;
         return NULL;
     }
@@ -504,6 +556,7 @@ extern "C" void* chk_realloc(void* ptr, size_t bytes) {
         // copy the data out.
         void* newMem = g_malloc_dispatch->malloc(size);
         if (newMem == NULL) {
+            add(old_hdr, old_hdr->size);
             return NULL;
         }
         memcpy(newMem, hdr, sizeof(hdr_t) + hdr->size);
@@ -518,6 +571,7 @@ extern "C" void* chk_realloc(void* ptr, size_t bytes) {
         add(hdr, bytes);
         return user(hdr);
     }
+    add(old_hdr, old_hdr->size);
     return NULL;
 }
 
@@ -612,26 +666,31 @@ static void ReportMemoryLeaks() {
     exe[count] = '\0';
   }
 
-  if (g_allocated_block_count == 0) {
+  const size_t total = allocated_block_count();
+  if (total == 0) {
     log_message("+++ %s did not leak", exe);
-    return;
   }
 
   size_t index = 1;
-  const size_t total = g_allocated_block_count;
-  while (head != NULL) {
-    int safe;
-    hdr_t* block = head;
-    log_message("+++ %s leaked block of size %d at %p (leak %d of %d)",
-                exe, block->size, user(block), index++, total);
-    if (del_leak(block, &safe) && g_backtrace_enabled) {
-      /* safe == 1, because the allocation is valid */
-      log_backtrace(block->bt, block->bt_depth);
+  for (size_t i = 0; i < ALLOCATION_SHARDS; ++i) {
+    allocation_shard_t* shard = &g_allocation_shards[i];
+    while (shard->head != NULL) {
+      int safe;
+      hdr_t* block = shard->head;
+      log_message("+++ %s leaked block of size %d at %p (leak %d of %d)",
+                  exe, block->size, user(block), index++, total);
+      if (del_leak(block, &safe) && g_backtrace_enabled) {
+        /* safe == 1, because the allocation is valid */
+        log_backtrace(block->bt, block->bt_depth);
+      }
     }
   }
 
-  while (backlog_head != NULL) {
-    del_from_backlog(backlog_tail);
+  for (size_t i = 0; i < g_malloc_debug_backlog; ++i) {
+    hdr_t* block = __atomic_exchange_n(&g_backlog[i], static_cast<hdr_t*>(NULL), __ATOMIC_ACQUIRE);
+    if (block != NULL) {
+      retire_from_backlog(block);
+    }
   }
 }
 
@@ -648,6 +707,14 @@ extern "C" bool malloc_debug_initialize(HashTable* hash_table, const MallocDebug
     g_malloc_debug_backlog = atoi(debug_backlog);
     info_log("%s: setting backlog length to %d\n", getprogname(), g_malloc_debug_backlog);
   }
+  if (g_malloc_debug_backlog > 0) {
+    g_backlog = reinterpret_cast<hdr_t* volatile*>(
+        malloc_dispatch->calloc(g_malloc_debug_backlog, sizeof(hdr_t*)));
+    if (g_backlog == NULL) {
+      error_log("%s: couldn't allocate malloc debug backlog", getprogname());
+      return false;
+    }
+  }
 
   // Check if backtracing should be disabled.
   char env[PROP_VALUE_MAX];
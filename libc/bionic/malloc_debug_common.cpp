@@ -40,12 +40,13 @@
 
 #include "malloc_debug_common.h"
 
+#include <errno.h>
+#include <malloc.h>
 #include <pthread.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 
-#include "private/ScopedPthreadMutexLocker.h"
-
 #if defined(USE_JEMALLOC)
 #include "jemalloc.h"
 #define Malloc(function)  je_ ## function
@@ -88,17 +89,23 @@ static const MallocDebug* __libc_malloc_dispatch = &__libc_malloc_default_dispat
 // when libc.debug.malloc environment variable contains value other than
 // zero:
 // 1  - For memory leak detections.
+// 2  - For sampled heap profiling: like 1, but only recording about one
+//      allocation per libc.debug.malloc.sample_rate bytes allocated (512KiB
+//      by default), which is cheap enough for production processes.
 // 5  - For filling allocated / freed memory with patterns defined by
 //      CHK_SENTINEL_VALUE, and CHK_FILL_FREE macros.
 // 10 - For adding pre-, and post- allocation stubs in order to detect
 //      buffer overruns.
+// 15 - For placing allocations against an inaccessible guard page so that
+//      buffer overruns fault immediately. Optionally only one allocation in
+//      libc.debug.malloc.guard_sample_rate is guarded.
 // Note that emulator's memory allocation instrumentation is not controlled by
 // libc.debug.malloc value, but rather by emulator, started with -memcheck
 // option. Note also, that if emulator has started with -memcheck option,
 // emulator's instrumented memory allocation will take over value saved in
 // libc.debug.malloc. In other words, if emulator has started with -memcheck
 // option, libc.debug.malloc value is ignored.
-// Actual functionality for debug levels 1-10 is implemented in
+// Actual functionality for debug levels 1-15 is implemented in
 // libc_malloc_debug_leak.so, while functionality for emulator's instrumented
 // allocations is implemented in libc_malloc_debug_qemu.so and can be run inside
 // the emulator only.
@@ -179,8 +186,9 @@ extern "C" void get_malloc_leak_info(uint8_t** info, size_t* overallSize,
   }
   *totalMemory = 0;
 
-  ScopedPthreadMutexLocker locker(&g_hash_table.lock);
-  if (g_hash_table.count == 0) {
+  ScopedHashTableLocker locker(&g_hash_table);
+  const size_t count = locker.count();
+  if (count == 0) {
     *info = NULL;
     *overallSize = 0;
     *infoSize = 0;
@@ -188,7 +196,7 @@ extern "C" void get_malloc_leak_info(uint8_t** info, size_t* overallSize,
     return;
   }
 
-  HashEntry** list = static_cast<HashEntry**>(Malloc(malloc)(sizeof(void*) * g_hash_table.count));
+  HashEntry** list = static_cast<HashEntry**>(Malloc(malloc)(sizeof(void*) * count));
 
   // Get the entries into an array to be sorted.
   size_t index = 0;
@@ -204,7 +212,7 @@ extern "C" void get_malloc_leak_info(uint8_t** info, size_t* overallSize,
 
   // XXX: the protocol doesn't allow variable size for the stack trace (yet)
   *infoSize = (sizeof(size_t) * 2) + (sizeof(uintptr_t) * BACKTRACE_SIZE);
-  *overallSize = *infoSize * g_hash_table.count;
+  *overallSize = *infoSize * count;
   *backtraceSize = BACKTRACE_SIZE;
 
   // now get a byte array big enough for this
@@ -215,10 +223,9 @@ extern "C" void get_malloc_leak_info(uint8_t** info, size_t* overallSize,
     return;
   }
 
-  qsort(list, g_hash_table.count, sizeof(void*), hash_entry_compare);
+  qsort(list, count, sizeof(void*), hash_entry_compare);
 
   uint8_t* head = *info;
-  const size_t count = g_hash_table.count;
   for (size_t i = 0 ; i < count ; ++i) {
     HashEntry* entry = list[i];
     size_t entrySize = (sizeof(size_t) * 2) + (sizeof(uintptr_t) * entry->numEntries);
@@ -251,6 +258,24 @@ extern "C" void free(void* mem) {
   __libc_malloc_dispatch->free(mem);
 }
 
+// The debug libraries keep their own headers in front of each allocation, so
+// the size the caller passes is only any use to the underlying allocator.
+extern "C" void free_sized(void* mem, size_t bytes) {
+  if (__predict_true(__libc_malloc_dispatch == &__libc_malloc_default_dispatch)) {
+    Malloc(free_sized)(mem, bytes);
+  } else {
+    __libc_malloc_dispatch->free(mem);
+  }
+}
+
+extern "C" void free_aligned_sized(void* mem, size_t alignment, size_t bytes) {
+  if (__predict_true(__libc_malloc_dispatch == &__libc_malloc_default_dispatch)) {
+    Malloc(free_aligned_sized)(mem, alignment, bytes);
+  } else {
+    __libc_malloc_dispatch->free(mem);
+  }
+}
+
 extern "C" struct mallinfo mallinfo() {
   return __libc_malloc_dispatch->mallinfo();
 }
@@ -287,6 +312,91 @@ extern "C" void* valloc(size_t bytes) {
 }
 #endif
 
+// =============================================================================
+// Returning memory to the kernel
+// =============================================================================
+
+// These go straight to the allocator, since the debug malloc libraries only
+// change what's allocated, not how the heap is managed.
+extern "C" int malloc_trim(size_t pad) {
+  return Malloc(malloc_trim)(pad);
+}
+
+// With M_DECAY_TIME set, a background thread calls malloc_trim every
+// g_decay_time seconds, so that a process's heap shrinks back after a burst
+// of allocations even if the process never calls malloc_trim itself.
+static pthread_mutex_t g_decay_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_decay_cond = PTHREAD_COND_INITIALIZER;
+static int g_decay_time = 0;
+static pid_t g_decay_thread_pid = 0;
+
+static void* decay_thread(void*) {
+  pthread_mutex_lock(&g_decay_lock);
+  while (true) {
+    if (g_decay_time == 0) {
+      pthread_cond_wait(&g_decay_cond, &g_decay_lock);
+      continue;
+    }
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += g_decay_time;
+    // A changed decay time wakes us up early so that it takes effect now.
+    if (pthread_cond_timedwait(&g_decay_cond, &g_decay_lock, &ts) == ETIMEDOUT) {
+      pthread_mutex_unlock(&g_decay_lock);
+      Malloc(malloc_trim)(0);
+      pthread_mutex_lock(&g_decay_lock);
+    }
+  }
+  return NULL;
+}
+
+static int set_decay_time(int seconds) {
+  if (seconds < 0) {
+    return 0;
+  }
+  pthread_mutex_lock(&g_decay_lock);
+  g_decay_time = seconds;
+  // Threads don't survive fork, so a child needs a thread of its own.
+  int result = 1;
+  if (seconds != 0 && g_decay_thread_pid != getpid()) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    if (pthread_create(&thread, &attr, decay_thread, NULL) == 0) {
+      g_decay_thread_pid = getpid();
+    } else {
+      result = 0;
+    }
+    pthread_attr_destroy(&attr);
+  }
+  pthread_cond_signal(&g_decay_cond);
+  pthread_mutex_unlock(&g_decay_lock);
+  return result;
+}
+
+extern "C" int mallopt(int param, int value) {
+  if (param == M_DECAY_TIME) {
+    return set_decay_time(value);
+  }
+  return Malloc(mallopt)(param, value);
+}
+
+// These always go to the underlying allocator, so with a debug level set the
+// reported allocations include the debug library's headers and guards.
+extern "C" int malloc_iterate(uintptr_t base, size_t size,
+                              void (*callback)(uintptr_t, size_t, void*), void* arg) {
+  return Malloc(malloc_iterate)(base, size, callback, arg);
+}
+
+extern "C" void malloc_disable() {
+  Malloc(malloc_disable)();
+}
+
+extern "C" void malloc_enable() {
+  Malloc(malloc_enable)();
+}
+
 // We implement malloc debugging only in libc.so, so the code below
 // must be excluded if we compile this file for static libc.a
 #ifndef LIBC_STATIC
@@ -355,8 +465,12 @@ static void malloc_init_impl() {
     g_malloc_debug_level = atoi(env);
   }
 
-  // Debug level 0 means that we should use default allocation routines.
+  // Debug level 0 means that we should use default allocation routines,
+  // counting allocations if libc.malloc.stats is set.
   if (g_malloc_debug_level == 0) {
+    if (malloc_stats_initialize()) {
+      __libc_malloc_dispatch = &__libc_malloc_stats_dispatch;
+    }
     return;
   }
 
@@ -378,8 +492,10 @@ static void malloc_init_impl() {
   // Choose the appropriate .so for the requested debug level.
   switch (g_malloc_debug_level) {
     case 1:
+    case 2:
     case 5:
     case 10:
+    case 15:
       so_name = "libc_malloc_debug_leak.so";
       break;
     case 20:
@@ -441,18 +557,24 @@ static void malloc_init_impl() {
   }
 
   // No need to init the dispatch table because we can only get
-  // here if debug level is 1, 5, 10, or 20.
+  // here if debug level is 1, 2, 5, 10, 15, or 20.
   static MallocDebug malloc_dispatch_table __attribute__((aligned(32)));
   switch (g_malloc_debug_level) {
     case 1:
       InitMalloc(malloc_impl_handle, &malloc_dispatch_table, "leak");
       break;
+    case 2:
+      InitMalloc(malloc_impl_handle, &malloc_dispatch_table, "sample");
+      break;
     case 5:
       InitMalloc(malloc_impl_handle, &malloc_dispatch_table, "fill");
       break;
     case 10:
       InitMalloc(malloc_impl_handle, &malloc_dispatch_table, "chk");
       break;
+    case 15:
+      InitMalloc(malloc_impl_handle, &malloc_dispatch_table, "guard");
+      break;
     case 20:
       InitMalloc(malloc_impl_handle, &malloc_dispatch_table, "qemu_instrumented");
       break;
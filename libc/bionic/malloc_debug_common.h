@@ -38,9 +38,11 @@
 #include <stdlib.h>
 
 #include "private/bionic_config.h"
+#include "private/bionic_macros.h"
 #include "private/libc_logging.h"
 
 #define HASHTABLE_SIZE      1543
+#define HASHTABLE_SHARDS    16
 #define BACKTRACE_SIZE      32
 /* flag definitions, currently sharing storage with "size" */
 #define SIZE_FLAG_ZYGOTE_CHILD  (1<<31)
@@ -66,12 +68,54 @@ struct HashEntry {
     uintptr_t backtrace[0];
 };
 
-struct HashTable {
+// Each slot belongs to shard (slot % HASHTABLE_SHARDS), whose lock must be held
+// to add entries to or remove entries from that slot's chain. An entry's
+// "allocations" count can be changed atomically without the lock as long as
+// it doesn't drop to zero; see release_entry in malloc_debug_leak.cpp.
+struct HashTableShard {
     pthread_mutex_t lock;
     size_t count;
+} __attribute__((aligned(64)));
+
+struct HashTable {
+    HashTableShard shards[HASHTABLE_SHARDS];
     HashEntry* slots[HASHTABLE_SIZE];
 };
 
+static inline HashTableShard* hash_table_shard(HashTable* table, size_t slot) {
+    return &table->shards[slot % HASHTABLE_SHARDS];
+}
+
+// Locks every shard, for code that needs to see the whole table.
+class ScopedHashTableLocker {
+ public:
+  explicit ScopedHashTableLocker(HashTable* table) : table_(table) {
+    for (size_t i = 0; i < HASHTABLE_SHARDS; ++i) {
+      pthread_mutex_lock(&table_->shards[i].lock);
+    }
+  }
+
+  ~ScopedHashTableLocker() {
+    for (size_t i = HASHTABLE_SHARDS; i > 0; --i) {
+      pthread_mutex_unlock(&table_->shards[i - 1].lock);
+    }
+  }
+
+  // The number of entries in the table.
+  size_t count() const {
+    size_t result = 0;
+    for (size_t i = 0; i < HASHTABLE_SHARDS; ++i) {
+      result += table_->shards[i].count;
+    }
+    return result;
+  }
+
+ private:
+  HashTable* table_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedHashTableLocker);
+};
+
 /* Entry in malloc dispatch table. */
 typedef void* (*MallocDebugCalloc)(size_t, size_t);
 typedef void (*MallocDebugFree)(void*);
@@ -108,6 +152,11 @@ struct MallocDebug {
 typedef bool (*MallocDebugInit)(HashTable*, const MallocDebug*);
 typedef void (*MallocDebugFini)(int);
 
+// Allocation statistics (malloc_stats.cpp). The statistics dispatch table is
+// only used if malloc_stats_initialize returns true.
+__LIBC_HIDDEN__ extern const MallocDebug __libc_malloc_stats_dispatch;
+__LIBC_HIDDEN__ bool malloc_stats_initialize();
+
 // =============================================================================
 // log functions
 // =============================================================================
@@ -0,0 +1,421 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+// Guard page allocations (libc.debug.malloc level 15).
+//
+// Some allocations are placed at the end of their own pages, immediately
+// followed by an inaccessible page, so that running off the end faults on the
+// offending instruction rather than being noticed (if at all) on free. When a
+// guarded allocation is freed its pages are made inaccessible too, so use
+// after free also faults until the slot is reused.
+//
+// Guarded allocations come from a fixed pool of libc.debug.malloc.guard_slots
+// slots, each big enough for libc.debug.malloc.guard_max_size bytes. Only
+// about one in libc.debug.malloc.guard_sample_rate allocations that fit is
+// guarded; everything else, and anything that doesn't fit or finds the pool
+// full, goes to the regular allocator. The default rate of 1 guards every
+// allocation that fits, electric-fence style; a higher rate keeps the memory
+// and system call overhead low enough for canary deployments.
+//
+// Allocations are only right-aligned to MALLOC_ALIGNMENT (or the requested
+// alignment), so an overrun of less than that many bytes may go undetected.
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/param.h>
+#include <sys/system_properties.h>
+#include <unistd.h>
+
+#include "malloc_debug_common.h"
+#include "malloc_debug_disable.h"
+#include "private/bionic_macros.h"
+#include "private/libc_logging.h"
+#include "private/ScopedPthreadMutexLocker.h"
+
+#define DEFAULT_GUARD_SAMPLE_RATE 1
+#define DEFAULT_GUARD_MAX_SIZE    4096
+#define DEFAULT_GUARD_SLOTS       1024
+
+struct GuardSlot {
+  void* mem;  // NULL if the slot is free.
+  size_t size;
+};
+
+struct GuardState {
+  size_t allocations_until_guard;
+  uint32_t random;
+};
+
+extern const MallocDebug* g_malloc_dispatch;
+
+static size_t g_guard_sample_rate = DEFAULT_GUARD_SAMPLE_RATE;
+static pthread_key_t g_guard_state_key;
+static pthread_once_t g_guard_init_once = PTHREAD_ONCE_INIT;
+
+// The pool is g_guard_slot_count slots of g_guard_slot_size bytes: the data
+// pages of each slot are followed by its guard page. Only the pages actually
+// used by a live allocation are ever accessible.
+static char* g_guard_pool;
+static size_t g_guard_pool_size;
+static size_t g_guard_data_size;
+static size_t g_guard_slot_size;
+static size_t g_guard_slot_count;
+
+// Free slots are reused oldest first, to keep freed memory inaccessible for as
+// long as possible. All protected by g_guard_lock.
+static pthread_mutex_t g_guard_lock = PTHREAD_MUTEX_INITIALIZER;
+static GuardSlot* g_guard_slots;
+static size_t* g_guard_free_slots;
+static size_t g_guard_free_head;
+static size_t g_guard_free_count;
+
+static struct sigaction g_previous_sigsegv_action;
+
+static inline bool is_guarded(const void* mem) {
+  return static_cast<size_t>(reinterpret_cast<const char*>(mem) - g_guard_pool) < g_guard_pool_size;
+}
+
+static inline size_t guard_slot_index(const void* mem) {
+  return (reinterpret_cast<const char*>(mem) - g_guard_pool) / g_guard_slot_size;
+}
+
+static inline char* guard_slot_data(size_t index) {
+  return g_guard_pool + index * g_guard_slot_size;
+}
+
+static void guard_state_destroy(void* state) {
+  g_malloc_dispatch->free(state);
+}
+
+// If a fault is in the pool, say which allocation it was and why, then put
+// back the previous handler. Returning retries the access, which faults again
+// and is reported (by debuggerd, usually) as normal.
+static void guard_sigsegv(int, siginfo_t* info, void*) {
+  if (is_guarded(info->si_addr)) {
+    const char* addr = reinterpret_cast<const char*>(info->si_addr);
+    size_t index = guard_slot_index(addr);
+    const GuardSlot* slot = &g_guard_slots[index];
+    const char* mem = reinterpret_cast<const char*>(slot->mem);
+    if (mem == NULL) {
+      __libc_format_log(ANDROID_LOG_ERROR, "libc",
+                        "+++ ACCESS %p IS TO A GUARDED ALLOCATION THAT WAS FREED\n", addr);
+    } else if (addr >= guard_slot_data(index) + g_guard_data_size) {
+      __libc_format_log(ANDROID_LOG_ERROR, "libc",
+                        "+++ ACCESS %p IS %zu BYTES PAST THE END OF ALLOCATION %p SIZE %zu\n",
+                        addr, addr - (mem + slot->size), mem, slot->size);
+    } else {
+      __libc_format_log(ANDROID_LOG_ERROR, "libc",
+                        "+++ ACCESS %p IS %zu BYTES BEFORE ALLOCATION %p SIZE %zu\n",
+                        addr, mem - addr, mem, slot->size);
+    }
+  }
+  sigaction(SIGSEGV, &g_previous_sigsegv_action, NULL);
+}
+
+static size_t guard_property(const char* name, size_t default_value) {
+  char env[PROP_VALUE_MAX];
+  if (__system_property_get(name, env) && atoi(env) > 0) {
+    return atoi(env);
+  }
+  return default_value;
+}
+
+static void guard_init() {
+  ScopedDisableDebugCalls disable;
+
+  g_guard_sample_rate = guard_property("libc.debug.malloc.guard_sample_rate",
+                                       DEFAULT_GUARD_SAMPLE_RATE);
+  size_t max_size = guard_property("libc.debug.malloc.guard_max_size", DEFAULT_GUARD_MAX_SIZE);
+  size_t slot_count = guard_property("libc.debug.malloc.guard_slots", DEFAULT_GUARD_SLOTS);
+  pthread_key_create(&g_guard_state_key, guard_state_destroy);
+
+  size_t pagesize = getpagesize();
+  size_t data_size = BIONIC_ALIGN(max_size, pagesize);
+  size_t slot_size = data_size + pagesize;
+  if (slot_size < max_size || SIZE_MAX / slot_size < slot_count) {
+    error_log("%s: guard pool of %zu slots of %zu bytes is too large\n",
+              getprogname(), slot_count, max_size);
+    return;
+  }
+
+  g_guard_slots = reinterpret_cast<GuardSlot*>(
+      g_malloc_dispatch->calloc(slot_count, sizeof(GuardSlot)));
+  g_guard_free_slots = reinterpret_cast<size_t*>(
+      g_malloc_dispatch->calloc(slot_count, sizeof(size_t)));
+  void* pool = mmap(NULL, slot_count * slot_size, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (g_guard_slots == NULL || g_guard_free_slots == NULL || pool == MAP_FAILED) {
+    error_log("%s: couldn't allocate guard pool: %s\n", getprogname(), strerror(errno));
+    g_malloc_dispatch->free(g_guard_slots);
+    g_malloc_dispatch->free(g_guard_free_slots);
+    if (pool != MAP_FAILED) {
+      munmap(pool, slot_count * slot_size);
+    }
+    return;
+  }
+  for (size_t i = 0; i < slot_count; ++i) {
+    g_guard_free_slots[i] = i;
+  }
+  g_guard_free_count = slot_count;
+  g_guard_slot_count = slot_count;
+  g_guard_data_size = data_size;
+  g_guard_slot_size = slot_size;
+  g_guard_pool = reinterpret_cast<char*>(pool);
+  g_guard_pool_size = slot_count * slot_size;
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = guard_sigsegv;
+  action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+  sigaction(SIGSEGV, &action, &g_previous_sigsegv_action);
+
+  info_log("%s: guarding one in %zu allocations of up to %zu bytes (%zu slots)\n",
+           getprogname(), g_guard_sample_rate, max_size, slot_count);
+}
+
+// Returns a count drawn uniformly from [1, 2 * g_guard_sample_rate - 1], so on
+// average one in g_guard_sample_rate allocations is guarded, but not
+// predictably which.
+static size_t next_guard_interval(GuardState* state) {
+  if (g_guard_sample_rate == 1) {
+    return 1;
+  }
+  // xorshift32.
+  uint32_t x = state->random;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  state->random = x;
+  return 1 + x % (2 * g_guard_sample_rate - 1);
+}
+
+static bool should_guard(size_t bytes, size_t alignment) {
+  pthread_once(&g_guard_init_once, guard_init);
+  // The data pages start page aligned, so any alignment up to a page can be
+  // met by moving down from the guard page without leaving the slot.
+  if (bytes > g_guard_data_size || alignment > static_cast<size_t>(getpagesize())) {
+    return false;
+  }
+
+  GuardState* state = reinterpret_cast<GuardState*>(pthread_getspecific(g_guard_state_key));
+  if (state == NULL) {
+    state = reinterpret_cast<GuardState*>(g_malloc_dispatch->malloc(sizeof(GuardState)));
+    if (state == NULL) {
+      return false;
+    }
+    state->random = (gettid() * 2654435761U) | 1;
+    state->allocations_until_guard = next_guard_interval(state);
+    pthread_setspecific(g_guard_state_key, state);
+  }
+
+  if (--state->allocations_until_guard > 0) {
+    return false;
+  }
+  state->allocations_until_guard = next_guard_interval(state);
+  return true;
+}
+
+// Returns NULL if the pool is full, in which case the caller should fall back
+// to the regular allocator. The memory is always zeroed.
+static void* guard_alloc(size_t bytes, size_t alignment) {
+  ScopedPthreadMutexLocker locker(&g_guard_lock);
+  if (g_guard_free_count == 0) {
+    return NULL;
+  }
+  size_t index = g_guard_free_slots[g_guard_free_head];
+
+  char* guard = guard_slot_data(index) + g_guard_data_size;
+  uintptr_t mem = reinterpret_cast<uintptr_t>(guard - bytes) & ~(alignment - 1);
+  size_t accessible = BIONIC_ALIGN(reinterpret_cast<uintptr_t>(guard) - mem, getpagesize());
+  if (mprotect(guard - accessible, accessible, PROT_READ | PROT_WRITE) != 0) {
+    return NULL;
+  }
+
+  g_guard_free_head = (g_guard_free_head + 1) % g_guard_slot_count;
+  --g_guard_free_count;
+  g_guard_slots[index].mem = reinterpret_cast<void*>(mem);
+  g_guard_slots[index].size = bytes;
+  return reinterpret_cast<void*>(mem);
+}
+
+static void guard_release(void* mem) {
+  size_t index = guard_slot_index(mem);
+  char* data = guard_slot_data(index);
+
+  ScopedPthreadMutexLocker locker(&g_guard_lock);
+  GuardSlot* slot = &g_guard_slots[index];
+  if (slot->mem != mem) {
+    error_log("+++ ALLOCATION %p IS %s\n", mem,
+              (slot->mem == NULL) ? "MULTIPLY FREED" : "NOT THE START OF A GUARDED ALLOCATION");
+    return;
+  }
+  slot->mem = NULL;
+
+  // Dropping the pages also means the slot's memory is zero when it's reused.
+  madvise(data, g_guard_data_size, MADV_DONTNEED);
+  mprotect(data, g_guard_data_size, PROT_NONE);
+  size_t tail = (g_guard_free_head + g_guard_free_count) % g_guard_slot_count;
+  g_guard_free_slots[tail] = index;
+  ++g_guard_free_count;
+}
+
+extern "C" void* guard_memalign(size_t alignment, size_t bytes) {
+  if (DebugCallsDisabled()) {
+    return g_malloc_dispatch->memalign(alignment, bytes);
+  }
+
+  if (alignment < MALLOC_ALIGNMENT) {
+    alignment = MALLOC_ALIGNMENT;
+  } else if (!powerof2(alignment)) {
+    alignment = BIONIC_ROUND_UP_POWER_OF_2(alignment);
+  }
+  if (should_guard(bytes, alignment)) {
+    void* mem = guard_alloc(bytes, alignment);
+    if (mem != NULL) {
+      return mem;
+    }
+  }
+  return g_malloc_dispatch->memalign(alignment, bytes);
+}
+
+extern "C" void* guard_malloc(size_t bytes) {
+  if (DebugCallsDisabled()) {
+    return g_malloc_dispatch->malloc(bytes);
+  }
+
+  if (should_guard(bytes, MALLOC_ALIGNMENT)) {
+    void* mem = guard_alloc(bytes, MALLOC_ALIGNMENT);
+    if (mem != NULL) {
+      return mem;
+    }
+  }
+  return g_malloc_dispatch->malloc(bytes);
+}
+
+extern "C" void guard_free(void* mem) {
+  // Even with debug calls disabled, guarded memory must go back to the pool.
+  if (is_guarded(mem)) {
+    guard_release(mem);
+    return;
+  }
+  g_malloc_dispatch->free(mem);
+}
+
+extern "C" void* guard_calloc(size_t n_elements, size_t elem_size) {
+  if (DebugCallsDisabled()) {
+    return g_malloc_dispatch->calloc(n_elements, elem_size);
+  }
+
+  size_t bytes = n_elements * elem_size;
+  if (n_elements != 0 && SIZE_MAX / n_elements < elem_size) {
+    errno = ENOMEM;
+    return NULL;
+  }
+  if (should_guard(bytes, MALLOC_ALIGNMENT)) {
+    // Guarded memory is fresh pages, so it's already zeroed.
+    void* mem = guard_alloc(bytes, MALLOC_ALIGNMENT);
+    if (mem != NULL) {
+      return mem;
+    }
+  }
+  return g_malloc_dispatch->calloc(n_elements, elem_size);
+}
+
+extern "C" size_t guard_malloc_usable_size(const void* mem) {
+  if (is_guarded(mem)) {
+    // Anything past the requested size would run into the guard page (or
+    // isn't checked), so there's no extra room we can report here.
+    return g_guard_slots[guard_slot_index(mem)].size;
+  }
+  return g_malloc_dispatch->malloc_usable_size(mem);
+}
+
+extern "C" void* guard_realloc(void* old_mem, size_t bytes) {
+  if (old_mem == NULL) {
+    return guard_malloc(bytes);
+  }
+  if (!is_guarded(old_mem)) {
+    // Leave resizing of regular allocations to the regular allocator; the
+    // next allocation will be sampled instead.
+    return g_malloc_dispatch->realloc(old_mem, bytes);
+  }
+
+  size_t old_size = guard_malloc_usable_size(old_mem);
+  void* new_mem = guard_malloc(bytes);
+  if (new_mem == NULL) {
+    return NULL;
+  }
+  memcpy(new_mem, old_mem, MIN(old_size, bytes));
+  guard_release(old_mem);
+  return new_mem;
+}
+
+extern "C" struct mallinfo guard_mallinfo() {
+  return g_malloc_dispatch->mallinfo();
+}
+
+extern "C" int guard_posix_memalign(void** memptr, size_t alignment, size_t size) {
+  if (DebugCallsDisabled()) {
+    return g_malloc_dispatch->posix_memalign(memptr, alignment, size);
+  }
+
+  if (!powerof2(alignment)) {
+    return EINVAL;
+  }
+  int saved_errno = errno;
+  *memptr = guard_memalign(alignment, size);
+  errno = saved_errno;
+  return (*memptr != NULL) ? 0 : ENOMEM;
+}
+
+#if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
+extern "C" void* guard_pvalloc(size_t bytes) {
+  if (DebugCallsDisabled()) {
+    return g_malloc_dispatch->pvalloc(bytes);
+  }
+
+  size_t pagesize = getpagesize();
+  size_t size = BIONIC_ALIGN(bytes, pagesize);
+  if (size < bytes) { // Overflow
+    return NULL;
+  }
+  return guard_memalign(pagesize, size);
+}
+
+extern "C" void* guard_valloc(size_t size) {
+  if (DebugCallsDisabled()) {
+    return g_malloc_dispatch->valloc(size);
+  }
+  return guard_memalign(getpagesize(), size);
+}
+#endif
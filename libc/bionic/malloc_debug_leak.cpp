@@ -30,6 +30,7 @@
 #include <dlfcn.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <math.h>
 #include <pthread.h>
 #include <stdarg.h>
 #include <stddef.h>
@@ -94,14 +95,19 @@ static inline const AllocationEntry* const_to_header(const void* mem) {
 // Hash Table functions
 // =============================================================================
 
+// Mixes each frame in with a 64-bit multiply and xorshift (after splitmix64), so
+// that backtraces differing only in a frame's low bits or in frame order still
+// land in different slots, and different shards.
 static uint32_t get_hash(uintptr_t* backtrace, size_t numEntries) {
     if (backtrace == NULL) return 0;
 
-    int hash = 0;
-    size_t i;
-    for (i = 0 ; i < numEntries ; i++) {
-        hash = (hash * 33) + (backtrace[i] >> 2);
+    uint64_t hash = numEntries;
+    for (size_t i = 0; i < numEntries; ++i) {
+        hash = (hash ^ backtrace[i]) * 0x9e3779b97f4a7c15ULL;
+        hash ^= hash >> 29;
     }
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 32;
 
     return hash;
 }
@@ -140,10 +146,14 @@ static HashEntry* record_backtrace(uintptr_t* backtrace, size_t numEntries, size
         size |= SIZE_FLAG_ZYGOTE_CHILD;
     }
 
+    HashTableShard* shard = hash_table_shard(g_hash_table, slot);
+    ScopedPthreadMutexLocker locker(&shard->lock);
+
     HashEntry* entry = find_entry(g_hash_table, slot, backtrace, numEntries, size);
 
     if (entry != NULL) {
-        entry->allocations++;
+        // Other threads may be in release_entry without the lock.
+        __sync_fetch_and_add(&entry->allocations, 1);
     } else {
         // create a new entry
         entry = static_cast<HashEntry*>(g_malloc_dispatch->malloc(sizeof(HashEntry) + numEntries*sizeof(uintptr_t)));
@@ -166,7 +176,7 @@ static HashEntry* record_backtrace(uintptr_t* backtrace, size_t numEntries, size
         }
 
         // we just added an entry, increase the size of the hashtable
-        g_hash_table->count++;
+        shard->count++;
     }
 
     return entry;
@@ -174,19 +184,23 @@ static HashEntry* record_backtrace(uintptr_t* backtrace, size_t numEntries, size
 
 static int is_valid_entry(HashEntry* entry) {
   if (entry != NULL) {
-    for (size_t i = 0; i < HASHTABLE_SIZE; ++i) {
-      HashEntry* e1 = g_hash_table->slots[i];
-      while (e1 != NULL) {
-        if (e1 == entry) {
-          return 1;
+    for (size_t shard = 0; shard < HASHTABLE_SHARDS; ++shard) {
+      ScopedPthreadMutexLocker locker(&g_hash_table->shards[shard].lock);
+      for (size_t i = shard; i < HASHTABLE_SIZE; i += HASHTABLE_SHARDS) {
+        HashEntry* e1 = g_hash_table->slots[i];
+        while (e1 != NULL) {
+          if (e1 == entry) {
+            return 1;
+          }
+          e1 = e1->next;
         }
-        e1 = e1->next;
       }
     }
   }
   return 0;
 }
 
+// Must be called with the entry's shard locked.
 static void remove_entry(HashEntry* entry) {
   HashEntry* prev = entry->prev;
   HashEntry* next = entry->next;
@@ -200,7 +214,30 @@ static void remove_entry(HashEntry* entry) {
   }
 
   // we just removed and entry, decrease the size of the hashtable
-  g_hash_table->count--;
+  hash_table_shard(g_hash_table, entry->slot)->count--;
+}
+
+// Drops one allocation from the entry, removing it if that was the last one.
+static void release_entry(HashEntry* entry) {
+  // Entries are only added and removed with their shard locked, so while
+  // there's another allocation keeping the entry alive we can just decrement.
+  size_t allocations = entry->allocations;
+  while (allocations > 1) {
+    size_t old_allocations = __sync_val_compare_and_swap(&entry->allocations, allocations,
+                                                         allocations - 1);
+    if (old_allocations == allocations) {
+      return;
+    }
+    allocations = old_allocations;
+  }
+
+  // This might be the last allocation; another thread might be about to find
+  // the entry and add one, so decide with the lock held.
+  ScopedPthreadMutexLocker locker(&hash_table_shard(g_hash_table, entry->slot)->lock);
+  if (__sync_sub_and_fetch(&entry->allocations, 1) == 0) {
+    remove_entry(entry);
+    g_malloc_dispatch->free(entry);
+  }
 }
 
 // =============================================================================
@@ -309,8 +346,6 @@ extern "C" void* leak_malloc(size_t bytes) {
 
     void* base = g_malloc_dispatch->malloc(size);
     if (base != NULL) {
-        ScopedPthreadMutexLocker locker(&g_hash_table->lock);
-
         uintptr_t backtrace[BACKTRACE_SIZE];
         size_t numEntries = GET_BACKTRACE(backtrace, BACKTRACE_SIZE);
 
@@ -335,8 +370,6 @@ extern "C" void leak_free(void* mem) {
     return;
   }
 
-  ScopedPthreadMutexLocker locker(&g_hash_table->lock);
-
   // check the guard to make sure it is valid
   AllocationEntry* header = to_header(mem);
 
@@ -351,11 +384,8 @@ extern "C" void leak_free(void* mem) {
 
   if (header->guard == GUARD || is_valid_entry(header->entry)) {
     // decrement the allocations
-    HashEntry* entry = header->entry;
-    entry->allocations--;
-    if (entry->allocations <= 0) {
-      remove_entry(entry);
-      g_malloc_dispatch->free(entry);
+    if (header->entry != NULL) {
+      release_entry(header->entry);
     }
 
     // now free the memory!
@@ -532,3 +562,273 @@ extern "C" void* leak_valloc(size_t size) {
   return leak_memalign(getpagesize(), size);
 }
 #endif
+
+// =============================================================================
+// malloc sampling functions
+// =============================================================================
+
+// Recording a backtrace for every allocation is far too slow for production
+// processes, so this level only records about one allocation per sample rate
+// bytes allocated. The gaps between samples are exponentially distributed, so
+// every byte is equally likely to be sampled, and an allocation of size s is
+// sampled with probability 1 - exp(-s / rate). get_malloc_leak_info reports the
+// sampled allocations that are still live; to estimate the whole heap, weight
+// each one by 1 / (1 - exp(-s / rate)).
+
+#define DEFAULT_SAMPLE_RATE (512 * 1024)
+#define SAMPLE_TABLE_SIZE   1543
+#define SAMPLE_FILTER_SIZE  65536
+
+struct SampleState {
+  size_t bytes_until_sample;
+  uint32_t random;
+};
+
+struct SampledAllocation {
+  void* mem;
+  HashEntry* entry;
+  SampledAllocation* next;
+};
+
+static size_t g_sample_rate = DEFAULT_SAMPLE_RATE;
+static pthread_key_t g_sample_state_key;
+static pthread_once_t g_sample_init_once = PTHREAD_ONCE_INIT;
+
+// The live sampled allocations, protected by g_sample_lock.
+static pthread_mutex_t g_sample_lock = PTHREAD_MUTEX_INITIALIZER;
+static SampledAllocation* g_sampled_allocations[SAMPLE_TABLE_SIZE];
+
+// How many live sampled allocations hash to each slot. This lets free skip the
+// lock for the vast majority of pointers, which were never sampled. Only
+// changed with g_sample_lock held.
+static volatile uint16_t g_sample_filter[SAMPLE_FILTER_SIZE];
+
+static inline size_t sample_table_slot(const void* mem) {
+  return (reinterpret_cast<uintptr_t>(mem) / MALLOC_ALIGNMENT) % SAMPLE_TABLE_SIZE;
+}
+
+static inline size_t sample_filter_slot(const void* mem) {
+  uintptr_t p = reinterpret_cast<uintptr_t>(mem) / MALLOC_ALIGNMENT;
+  return (p ^ (p >> 16)) % SAMPLE_FILTER_SIZE;
+}
+
+static void sample_state_destroy(void* state) {
+  g_malloc_dispatch->free(state);
+}
+
+static void sample_init() {
+  char env[PROP_VALUE_MAX];
+  if (__system_property_get("libc.debug.malloc.sample_rate", env) && atoi(env) > 0) {
+    g_sample_rate = atoi(env);
+  }
+  info_log("%s: sampling one allocation per %zu bytes\n", getprogname(), g_sample_rate);
+  pthread_key_create(&g_sample_state_key, sample_state_destroy);
+}
+
+// Returns a number of bytes drawn from an exponential distribution with a
+// mean of g_sample_rate.
+static size_t next_sample_interval(SampleState* state) {
+  // xorshift32.
+  uint32_t x = state->random;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  state->random = x;
+
+  // -ln(q / 2^26) for q uniform in [1, 2^26]. We don't link against libm, so
+  // approximate log2 on the mantissa with a quadratic; that's plenty for this.
+  double m = (x >> 6) + 1;
+  int exponent = 0;
+  while (m >= 2.0) {
+    m *= 0.5;
+    ++exponent;
+  }
+  double log2_q = exponent + (-0.34484843 * m + 2.02466578) * m - 1.67981735;
+  double interval = (26 - log2_q) * M_LN2 * g_sample_rate;
+  return (interval < 1) ? 1 : static_cast<size_t>(interval);
+}
+
+static bool should_sample(size_t bytes) {
+  pthread_once(&g_sample_init_once, sample_init);
+
+  SampleState* state = reinterpret_cast<SampleState*>(pthread_getspecific(g_sample_state_key));
+  if (state == NULL) {
+    state = reinterpret_cast<SampleState*>(g_malloc_dispatch->malloc(sizeof(SampleState)));
+    if (state == NULL) {
+      return false;
+    }
+    state->random = (gettid() * 2654435761U) | 1;
+    state->bytes_until_sample = next_sample_interval(state);
+    pthread_setspecific(g_sample_state_key, state);
+  }
+
+  if (state->bytes_until_sample > bytes) {
+    state->bytes_until_sample -= bytes;
+    return false;
+  }
+  state->bytes_until_sample = next_sample_interval(state);
+  return true;
+}
+
+static void release_sample(SampledAllocation* sample) {
+  release_entry(sample->entry);
+  g_malloc_dispatch->free(sample);
+}
+
+static void insert_sample(SampledAllocation* sample) {
+  ScopedPthreadMutexLocker locker(&g_sample_lock);
+  size_t filter_slot = sample_filter_slot(sample->mem);
+  if (g_sample_filter[filter_slot] == UINT16_MAX) {
+    release_sample(sample);
+    return;
+  }
+  size_t slot = sample_table_slot(sample->mem);
+  sample->next = g_sampled_allocations[slot];
+  g_sampled_allocations[slot] = sample;
+  g_sample_filter[filter_slot] = g_sample_filter[filter_slot] + 1;
+}
+
+static void record_sample(void* mem, size_t bytes) {
+  if (bytes & SIZE_FLAG_MASK) {
+    return;
+  }
+
+  // Unwinding is the slow part, so do it before taking the lock.
+  uintptr_t backtrace[BACKTRACE_SIZE];
+  size_t numEntries = GET_BACKTRACE(backtrace, BACKTRACE_SIZE);
+
+  SampledAllocation* sample =
+      reinterpret_cast<SampledAllocation*>(g_malloc_dispatch->malloc(sizeof(SampledAllocation)));
+  if (sample == NULL) {
+    return;
+  }
+
+  sample->entry = record_backtrace(backtrace, numEntries, bytes);
+  if (sample->entry == NULL) {
+    g_malloc_dispatch->free(sample);
+    return;
+  }
+  sample->mem = mem;
+  insert_sample(sample);
+}
+
+// Removes and returns the sample for mem, or returns NULL if it wasn't sampled.
+static SampledAllocation* take_sample(void* mem) {
+  size_t filter_slot = sample_filter_slot(mem);
+  if (g_sample_filter[filter_slot] == 0) {
+    return NULL;
+  }
+
+  ScopedPthreadMutexLocker locker(&g_sample_lock);
+  SampledAllocation** link = &g_sampled_allocations[sample_table_slot(mem)];
+  while (*link != NULL && (*link)->mem != mem) {
+    link = &(*link)->next;
+  }
+  if (*link == NULL) {
+    return NULL;
+  }
+  SampledAllocation* sample = *link;
+  *link = sample->next;
+  g_sample_filter[filter_slot] = g_sample_filter[filter_slot] - 1;
+  return sample;
+}
+
+static void forget_sample(void* mem) {
+  SampledAllocation* sample = take_sample(mem);
+  if (sample != NULL) {
+    release_sample(sample);
+  }
+}
+
+static inline void* maybe_sample(void* mem, size_t bytes) {
+  if (mem != NULL && should_sample(bytes)) {
+    record_sample(mem, bytes);
+  }
+  return mem;
+}
+
+extern "C" void* sample_malloc(size_t bytes) {
+  void* mem = g_malloc_dispatch->malloc(bytes);
+  if (DebugCallsDisabled()) {
+    return mem;
+  }
+  return maybe_sample(mem, bytes);
+}
+
+extern "C" void sample_free(void* mem) {
+  // Even with debug calls disabled, a sampled allocation must not outlive its memory.
+  if (mem != NULL) {
+    forget_sample(mem);
+  }
+  g_malloc_dispatch->free(mem);
+}
+
+extern "C" void* sample_calloc(size_t n_elements, size_t elem_size) {
+  void* mem = g_malloc_dispatch->calloc(n_elements, elem_size);
+  if (DebugCallsDisabled()) {
+    return mem;
+  }
+  // calloc has already failed if this overflows.
+  return maybe_sample(mem, n_elements * elem_size);
+}
+
+extern "C" void* sample_realloc(void* oldMem, size_t bytes) {
+  // Take the old allocation's sample out first: once realloc returns, another
+  // thread might be given (and sample) the same address. If realloc fails, the
+  // old allocation is still live, so its sample goes back in.
+  SampledAllocation* oldSample = (oldMem != NULL) ? take_sample(oldMem) : NULL;
+  void* newMem = g_malloc_dispatch->realloc(oldMem, bytes);
+  if (oldSample != NULL) {
+    if (newMem == NULL && bytes != 0) {
+      insert_sample(oldSample);
+    } else {
+      release_sample(oldSample);
+    }
+  }
+  if (DebugCallsDisabled()) {
+    return newMem;
+  }
+  return maybe_sample(newMem, bytes);
+}
+
+extern "C" void* sample_memalign(size_t alignment, size_t bytes) {
+  void* mem = g_malloc_dispatch->memalign(alignment, bytes);
+  if (DebugCallsDisabled()) {
+    return mem;
+  }
+  return maybe_sample(mem, bytes);
+}
+
+extern "C" size_t sample_malloc_usable_size(const void* mem) {
+  return g_malloc_dispatch->malloc_usable_size(mem);
+}
+
+extern "C" struct mallinfo sample_mallinfo() {
+  return g_malloc_dispatch->mallinfo();
+}
+
+extern "C" int sample_posix_memalign(void** memptr, size_t alignment, size_t size) {
+  int result = g_malloc_dispatch->posix_memalign(memptr, alignment, size);
+  if (result == 0 && !DebugCallsDisabled()) {
+    maybe_sample(*memptr, size);
+  }
+  return result;
+}
+
+#if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
+extern "C" void* sample_pvalloc(size_t bytes) {
+  void* mem = g_malloc_dispatch->pvalloc(bytes);
+  if (DebugCallsDisabled()) {
+    return mem;
+  }
+  return maybe_sample(mem, bytes);
+}
+
+extern "C" void* sample_valloc(size_t bytes) {
+  void* mem = g_malloc_dispatch->valloc(bytes);
+  if (DebugCallsDisabled()) {
+    return mem;
+  }
+  return maybe_sample(mem, bytes);
+}
+#endif
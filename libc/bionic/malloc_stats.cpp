@@ -0,0 +1,387 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+// Allocation statistics, enabled with libc.malloc.stats=1 or LIBC_MALLOC_STATS=1.
+//
+// Each thread counts its own allocations and frees in a cache line aligned
+// block of counters that only it writes, so counting takes no locks and
+// shares no cache lines with other threads.
+// Readers add up all the blocks without a lock either: the list of blocks only
+// ever grows, and every counter is a single word. The totals can be slightly
+// out of date while other threads are allocating, which is fine for
+// statistics. When a thread exits its counts are folded into
+// g_exited_thread_stats and its block is reused by the next new thread.
+
+#include <malloc.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/system_properties.h>
+#include <unistd.h>
+
+#include "malloc_debug_common.h"
+#include "private/ScopedPthreadMutexLocker.h"
+
+#if defined(USE_JEMALLOC)
+#include "jemalloc.h"
+#define Malloc(function)  je_ ## function
+#elif defined(USE_DLMALLOC)
+#include "dlmalloc.h"
+#define Malloc(function)  dl ## function
+#else
+#error "Either one of USE_DLMALLOC or USE_JEMALLOC must be defined."
+#endif
+
+#define SIZE_CLASSES MALLOC_STATISTICS_SIZE_CLASSES
+
+struct ThreadStats {
+  ThreadStats* next;
+  volatile pid_t tid;  // 0 if the block is free.
+  size_t allocations[SIZE_CLASSES];
+  size_t frees[SIZE_CLASSES];
+  size_t allocated_bytes[SIZE_CLASSES];
+  size_t freed_bytes[SIZE_CLASSES];
+} __attribute__((aligned(64)));
+
+static bool g_stats_enabled = false;
+static pthread_key_t g_stats_key;
+
+// g_stats_lock is only needed to add blocks and to claim or release them.
+static pthread_mutex_t g_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static ThreadStats* volatile g_thread_stats;
+static ThreadStats g_exited_thread_stats;
+
+static inline size_t size_class(size_t size) {
+  if (size <= 16) {
+    return 0;
+  }
+  size_t bits = sizeof(unsigned long) * 8 - __builtin_clzl(size - 1);
+  return (bits - 4 < SIZE_CLASSES) ? bits - 4 : SIZE_CLASSES - 1;
+}
+
+static inline size_t size_class_max_size(size_t c) {
+  return (c < SIZE_CLASSES - 1) ? static_cast<size_t>(16) << c : SIZE_MAX;
+}
+
+static void thread_stats_destroy(void* arg) {
+  ThreadStats* stats = reinterpret_cast<ThreadStats*>(arg);
+  ScopedPthreadMutexLocker locker(&g_stats_lock);
+  for (size_t c = 0; c < SIZE_CLASSES; ++c) {
+    g_exited_thread_stats.allocations[c] += stats->allocations[c];
+    g_exited_thread_stats.frees[c] += stats->frees[c];
+    g_exited_thread_stats.allocated_bytes[c] += stats->allocated_bytes[c];
+    g_exited_thread_stats.freed_bytes[c] += stats->freed_bytes[c];
+  }
+  memset(stats->allocations, 0, sizeof(stats->allocations));
+  memset(stats->frees, 0, sizeof(stats->frees));
+  memset(stats->allocated_bytes, 0, sizeof(stats->allocated_bytes));
+  memset(stats->freed_bytes, 0, sizeof(stats->freed_bytes));
+  stats->tid = 0;
+}
+
+static ThreadStats* new_thread_stats() {
+  ThreadStats* stats = NULL;
+  {
+    ScopedPthreadMutexLocker locker(&g_stats_lock);
+    for (ThreadStats* s = g_thread_stats; s != NULL; s = s->next) {
+      if (s->tid == 0) {
+        stats = s;
+        break;
+      }
+    }
+    if (stats == NULL) {
+      stats = reinterpret_cast<ThreadStats*>(Malloc(memalign)(__alignof__(ThreadStats),
+                                                              sizeof(ThreadStats)));
+      if (stats == NULL) {
+        return NULL;
+      }
+      memset(stats, 0, sizeof(ThreadStats));
+      stats->next = g_thread_stats;
+      // Readers don't take the lock, so the block must be complete before it's visible.
+      __sync_synchronize();
+      g_thread_stats = stats;
+    }
+    stats->tid = gettid();
+  }
+  pthread_setspecific(g_stats_key, stats);
+  return stats;
+}
+
+static inline ThreadStats* thread_stats() {
+  ThreadStats* stats = reinterpret_cast<ThreadStats*>(pthread_getspecific(g_stats_key));
+  return (stats != NULL) ? stats : new_thread_stats();
+}
+
+static inline void* count_allocation(void* mem) {
+  if (mem != NULL) {
+    ThreadStats* stats = thread_stats();
+    if (stats != NULL) {
+      size_t size = Malloc(malloc_usable_size)(mem);
+      size_t c = size_class(size);
+      stats->allocations[c]++;
+      stats->allocated_bytes[c] += size;
+    }
+  }
+  return mem;
+}
+
+static inline void count_free(void* mem) {
+  if (mem != NULL) {
+    ThreadStats* stats = thread_stats();
+    if (stats != NULL) {
+      size_t size = Malloc(malloc_usable_size)(mem);
+      size_t c = size_class(size);
+      stats->frees[c]++;
+      stats->freed_bytes[c] += size;
+    }
+  }
+}
+
+static void* stats_calloc(size_t n_elements, size_t elem_size) {
+  return count_allocation(Malloc(calloc)(n_elements, elem_size));
+}
+
+static void stats_free(void* mem) {
+  count_free(mem);
+  Malloc(free)(mem);
+}
+
+static void* stats_malloc(size_t bytes) {
+  return count_allocation(Malloc(malloc)(bytes));
+}
+
+static void* stats_memalign(size_t alignment, size_t bytes) {
+  return count_allocation(Malloc(memalign)(alignment, bytes));
+}
+
+static int stats_posix_memalign(void** memptr, size_t alignment, size_t size) {
+  int result = Malloc(posix_memalign)(memptr, alignment, size);
+  if (result == 0) {
+    count_allocation(*memptr);
+  }
+  return result;
+}
+
+#if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
+static void* stats_pvalloc(size_t bytes) {
+  return count_allocation(Malloc(pvalloc)(bytes));
+}
+#endif
+
+static void* stats_realloc(void* old_mem, size_t bytes) {
+  // Count the old allocation as freed before realloc can hand it to another
+  // thread. If realloc fails it's still allocated, so count it again.
+  count_free(old_mem);
+  void* new_mem = Malloc(realloc)(old_mem, bytes);
+  if (new_mem == NULL && bytes != 0) {
+    count_allocation(old_mem);
+  }
+  return count_allocation(new_mem);
+}
+
+#if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
+static void* stats_valloc(size_t bytes) {
+  return count_allocation(Malloc(valloc)(bytes));
+}
+#endif
+
+const MallocDebug __libc_malloc_stats_dispatch __attribute__((aligned(32))) = {
+  stats_calloc,
+  stats_free,
+  Malloc(mallinfo),
+  stats_malloc,
+  Malloc(malloc_usable_size),
+  stats_memalign,
+  stats_posix_memalign,
+#if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
+  stats_pvalloc,
+#endif
+  stats_realloc,
+#if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
+  stats_valloc,
+#endif
+};
+
+static void add_thread_stats(malloc_statistics* result, const ThreadStats* stats) {
+  for (size_t c = 0; c < SIZE_CLASSES; ++c) {
+    malloc_size_class_statistics* sc = &result->classes[c];
+    sc->allocations += stats->allocations[c];
+    sc->frees += stats->frees[c];
+    sc->allocated_bytes += stats->allocated_bytes[c];
+    sc->freed_bytes += stats->freed_bytes[c];
+    result->allocations += stats->allocations[c];
+    result->frees += stats->frees[c];
+    result->allocated_bytes += stats->allocated_bytes[c];
+    result->freed_bytes += stats->freed_bytes[c];
+  }
+}
+
+static void init_statistics(malloc_statistics* result) {
+  memset(result, 0, sizeof(*result));
+  for (size_t c = 0; c < SIZE_CLASSES; ++c) {
+    result->classes[c].max_size = size_class_max_size(c);
+  }
+}
+
+// Doesn't take any locks, so it's safe to call from a signal handler.
+static void sum_thread_stats(malloc_statistics* result) {
+  init_statistics(result);
+  add_thread_stats(result, &g_exited_thread_stats);
+  for (const ThreadStats* s = g_thread_stats; s != NULL; s = s->next) {
+    add_thread_stats(result, s);
+  }
+}
+
+static size_t mapped_bytes() {
+#if defined(USE_JEMALLOC)
+  // Only available if jemalloc was built with statistics.
+  uint64_t epoch = 1;
+  size_t size = sizeof(epoch);
+  je_mallctl("epoch", &epoch, &size, &epoch, size);
+  size_t mapped;
+  size = sizeof(mapped);
+  return (je_mallctl("stats.mapped", &mapped, &size, NULL, 0) == 0) ? mapped : 0;
+#else
+  return Malloc(malloc_footprint)();
+#endif
+}
+
+extern "C" int malloc_get_statistics(malloc_statistics* result) {
+  if (!g_stats_enabled) {
+    errno = ENOTSUP;
+    return -1;
+  }
+  sum_thread_stats(result);
+  result->mapped_bytes = mapped_bytes();
+  return 0;
+}
+
+extern "C" int malloc_get_thread_statistics(malloc_statistics* result) {
+  if (!g_stats_enabled) {
+    errno = ENOTSUP;
+    return -1;
+  }
+  init_statistics(result);
+  ThreadStats* stats = thread_stats();
+  if (stats != NULL) {
+    add_thread_stats(result, stats);
+  }
+  result->mapped_bytes = mapped_bytes();
+  return 0;
+}
+
+// Called from a signal handler, so it can't use the log functions, which may
+// take locks. Each line is formatted on the stack and written to stderr.
+static void write_line(const char* line) {
+  size_t length = strlen(line);
+  while (length > 0) {
+    ssize_t written = write(STDERR_FILENO, line, length);
+    if (written <= 0) {
+      if (written == -1 && errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    line += written;
+    length -= written;
+  }
+}
+
+static void dump_statistics(int) {
+  int saved_errno = errno;
+  malloc_statistics stats;
+  sum_thread_stats(&stats);
+  // jemalloc's mallctl takes locks, so only dlmalloc can say how much is mapped here.
+#if defined(USE_DLMALLOC)
+  stats.mapped_bytes = mapped_bytes();
+#endif
+  char line[256];
+  __libc_format_buffer(line, sizeof(line),
+                       "+++ %s (%d) malloc statistics: %zu bytes in %zu allocations, %zu bytes mapped\n",
+                       getprogname(), getpid(), stats.allocated_bytes - stats.freed_bytes,
+                       stats.allocations - stats.frees, stats.mapped_bytes);
+  write_line(line);
+  for (size_t c = 0; c < SIZE_CLASSES; ++c) {
+    const malloc_size_class_statistics* sc = &stats.classes[c];
+    if (sc->allocations != 0) {
+      __libc_format_buffer(line, sizeof(line),
+                           "+++   up to %zu bytes: %zu bytes in %zu allocations (%zu allocated, %zu freed)\n",
+                           sc->max_size, sc->allocated_bytes - sc->freed_bytes,
+                           sc->allocations - sc->frees, sc->allocations, sc->frees);
+      write_line(line);
+    }
+  }
+  for (const ThreadStats* s = g_thread_stats; s != NULL; s = s->next) {
+    pid_t tid = s->tid;
+    if (tid != 0) {
+      malloc_statistics thread;
+      init_statistics(&thread);
+      add_thread_stats(&thread, s);
+      __libc_format_buffer(line, sizeof(line),
+                           "+++   thread %d: allocated %zu bytes in %zu allocations, freed %zu bytes in %zu\n",
+                           tid, thread.allocated_bytes, thread.allocations,
+                           thread.freed_bytes, thread.frees);
+      write_line(line);
+    }
+  }
+  errno = saved_errno;
+}
+
+// The environment overrides the system property, so that a single process (a
+// test, say) can be given statistics without turning them on for every process.
+static bool get_setting(const char* env_name, const char* property_name, char* value) {
+  const char* env = getenv(env_name);
+  if (env != NULL) {
+    strlcpy(value, env, PROP_VALUE_MAX);
+    return true;
+  }
+  return __system_property_get(property_name, value) > 0;
+}
+
+bool malloc_stats_initialize() {
+  char env[PROP_VALUE_MAX];
+  if (!get_setting("LIBC_MALLOC_STATS", "libc.malloc.stats", env) || atoi(env) == 0) {
+    return false;
+  }
+  if (pthread_key_create(&g_stats_key, thread_stats_destroy) != 0) {
+    return false;
+  }
+  g_stats_enabled = true;
+
+  if (get_setting("LIBC_MALLOC_STATS_SIGNAL", "libc.malloc.stats.signal", env) && atoi(env) > 0) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = dump_statistics;
+    action.sa_flags = SA_RESTART;
+    sigaction(atoi(env), &action, NULL);
+  }
+  return true;
+}
@@ -25,40 +25,45 @@
  * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
  * SUCH DAMAGE.
  */
-/*
- * This uses the "Not So Naive" algorithm, a very simple but
- * usually effective algorithm, see:
- * http://www-igm.univ-mlv.fr/~lecroq/string/
- */
+
 #include <string.h>
 
+#include "two_way.h"
+
 void *memmem(const void *haystack, size_t n, const void *needle, size_t m)
 {
+    const unsigned char*  y = (const unsigned char*) haystack;
+    const unsigned char*  x = (const unsigned char*) needle;
+    const unsigned char*  last;
+    const unsigned char*  p;
+    size_t                work = 0;
+
     if (m > n || !m || !n)
         return NULL;
 
-    if (__builtin_expect((m > 1), 1)) {
-        const unsigned char*  y = (const unsigned char*) haystack;
-        const unsigned char*  x = (const unsigned char*) needle;
-        size_t                j = 0;
-        size_t                k = 1, l = 2;
+    if (m == 1)
+        return memchr(haystack, x[0], n);
 
-        if (x[0] == x[1]) {
-            k = 2;
-            l = 1;
-        }
-        while (j <= n-m) {
-            if (x[1] != y[j+1]) {
-                j += k;
-            } else {
-                if (!memcmp(x+2, y+j+2, m-2) && x[0] == y[j])
-                    return (void*) &y[j];
-                j += l;
-            }
+    /*
+     * Jump between occurrences of the needle's first byte with memchr,
+     * which is vectorized on most architectures, and check the second
+     * byte before comparing the rest. That's quickest on real data but
+     * quadratic at worst, so once checking candidates has cost more than
+     * the distance covered, hand over to the linear-time Two-Way search.
+     */
+    last = y + n - m;
+    for (p = y; p <= last; p++) {
+        p = memchr(p, x[0], last - p + 1);
+        if (p == NULL)
+            return NULL;
+        work += TWO_WAY_CANDIDATE_COST;
+        if (p[1] == x[1]) {
+            if (!memcmp(p + 2, x + 2, m - 2))
+                return (void*) p;
+            work += m;
         }
-    } else {
-        /* degenerate case */
-        return memchr(haystack, ((unsigned char*)needle)[0], n);
+        if (work > (size_t) (p - y) + TWO_WAY_SCAN_SLACK)
+            return (void*) __two_way_search(p + 1, y + n, x, m, 0);
     }
     return NULL;
 }
@@ -15,6 +15,7 @@
  */
 
 #include <errno.h>
+#include <malloc.h>
 #include <new>
 #include <stdlib.h>
 
@@ -22,6 +23,14 @@
 
 const std::nothrow_t std::nothrow = {};
 
+// <new> only declares the sized and aligned operators to code built for a
+// standard that has them, but libc has to define them all.
+#if !defined(__cpp_aligned_new)
+namespace std {
+    enum class align_val_t : std::size_t {};
+}
+#endif
+
 void* operator new(std::size_t size) {
     void* p = malloc(size);
     if (p == NULL) {
@@ -61,3 +70,62 @@ void  operator delete(void* ptr, const std::nothrow_t&) {
 void  operator delete[](void* ptr, const std::nothrow_t&) {
     free(ptr);
 }
+
+// Passing the size on saves the allocator looking it up.
+void  operator delete(void* ptr, std::size_t size) {
+    free_sized(ptr, size);
+}
+
+void  operator delete[](void* ptr, std::size_t size) {
+    free_sized(ptr, size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    void* p = memalign(static_cast<std::size_t>(alignment), size);
+    if (p == NULL) {
+        __libc_fatal("new failed to allocate %zu bytes aligned to %zu", size,
+                     static_cast<std::size_t>(alignment));
+    }
+    return p;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    void* p = memalign(static_cast<std::size_t>(alignment), size);
+    if (p == NULL) {
+        __libc_fatal("new[] failed to allocate %zu bytes aligned to %zu", size,
+                     static_cast<std::size_t>(alignment));
+    }
+    return p;
+}
+
+void  operator delete(void* ptr, std::align_val_t) {
+    free(ptr);
+}
+
+void  operator delete[](void* ptr, std::align_val_t) {
+    free(ptr);
+}
+
+void  operator delete(void* ptr, std::size_t size, std::align_val_t alignment) {
+    free_aligned_sized(ptr, static_cast<std::size_t>(alignment), size);
+}
+
+void  operator delete[](void* ptr, std::size_t size, std::align_val_t alignment) {
+    free_aligned_sized(ptr, static_cast<std::size_t>(alignment), size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) {
+    return memalign(static_cast<std::size_t>(alignment), size);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) {
+    return memalign(static_cast<std::size_t>(alignment), size);
+}
+
+void  operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) {
+    free(ptr);
+}
+
+void  operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) {
+    free(ptr);
+}
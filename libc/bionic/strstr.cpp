@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <string.h>
+
+#include "two_way.h"
+
+char* strstr(const char* haystack, const char* needle) {
+  const unsigned char* h = reinterpret_cast<const unsigned char*>(haystack);
+  const unsigned char* n = reinterpret_cast<const unsigned char*>(needle);
+  if (n[0] == '\0') {
+    return const_cast<char*>(haystack);
+  }
+
+  // As in memmem, check each occurrence of the needle's first byte (found by
+  // the vectorized strchr) until that's cost more than it's covered, then
+  // switch to Two-Way so that adversarial input stays linear.
+  size_t work = 0;
+  for (const unsigned char* p = reinterpret_cast<const unsigned char*>(strchr(haystack, n[0]));
+       p != NULL;
+       p = reinterpret_cast<const unsigned char*>(strchr(reinterpret_cast<const char*>(p + 1), n[0]))) {
+    size_t i = 1;
+    while (n[i] != '\0' && p[i] == n[i]) {
+      ++i;
+    }
+    if (n[i] == '\0') {
+      return const_cast<char*>(reinterpret_cast<const char*>(p));
+    }
+    if (p[i] == '\0') {
+      // The haystack ends before the rest of the needle could.
+      return NULL;
+    }
+    work += i + TWO_WAY_CANDIDATE_COST;
+    if (work > static_cast<size_t>(p - h) + TWO_WAY_SCAN_SLACK) {
+      // We know the haystack runs at least as far as p[i].
+      return const_cast<char*>(reinterpret_cast<const char*>(
+          __two_way_search(p + 1, p + i, n, strlen(needle), 1)));
+    }
+  }
+  return NULL;
+}
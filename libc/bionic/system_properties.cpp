@@ -33,9 +33,11 @@
 #include <stddef.h>
 #include <errno.h>
 #include <poll.h>
+#include <pthread.h>
 #include <fcntl.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
 
 #include <sys/mman.h>
 
@@ -55,7 +57,8 @@
 #include "private/bionic_futex.h"
 #include "private/bionic_macros.h"
 
-static const char property_service_socket[] = "/dev/socket/" PROP_SERVICE_NAME;
+static char property_service_socket[sizeof(sockaddr_un::sun_path)] =
+        "/dev/socket/" PROP_SERVICE_NAME;
 
 
 /*
@@ -105,11 +108,17 @@ struct prop_area {
     volatile uint32_t serial;
     uint32_t magic;
     uint32_t version;
-    uint32_t reserved[28];
+    // In the main area, the offset of the first prop_area_link. Older
+    // versions of libc ignore this (it used to be reserved).
+    volatile uint32_t areas;
+    // The offset and size of the property index; see index_property.
+    volatile uint32_t index;
+    uint32_t index_mask;
+    uint32_t reserved[25];
     char data[0];
 
     prop_area(const uint32_t magic, const uint32_t version) :
-        serial(0), magic(magic), version(version) {
+        serial(0), magic(magic), version(version), areas(0), index(0), index_mask(0) {
         memset(reserved, 0, sizeof(reserved));
         // Allocate enough space for the root node.
         bytes_used = sizeof(prop_bt);
@@ -119,24 +128,71 @@ private:
     DISALLOW_COPY_AND_ASSIGN(prop_area);
 };
 
+/*
+ * Values too long for prop_info::value are stored after the name instead, and
+ * the serial gets SERIAL_LONG_FLAG. Long values are never updated, and updates
+ * of other values skip the counts that have the flag set. Readers that don't
+ * know about long values get long_value_notice.
+ */
+#define SERIAL_LONG_FLAG (1 << 16)
+
+static const char long_value_notice[] =
+        "Value too long: use __system_property_read_callback";
+
 struct prop_info {
     volatile uint32_t serial;
     char value[PROP_VALUE_MAX];
     char name[0];
 
-    prop_info(const char *name, const uint8_t namelen, const char *value,
-              const uint8_t valuelen) {
+    prop_info(const char *name, const size_t namelen, const char *value,
+              const size_t valuelen) {
         memcpy(this->name, name, namelen);
         this->name[namelen] = '\0';
-        this->serial = (valuelen << 24);
-        memcpy(this->value, value, valuelen);
-        this->value[valuelen] = '\0';
+        if (valuelen < PROP_VALUE_MAX) {
+            this->serial = (valuelen << 24);
+            memcpy(this->value, value, valuelen);
+            this->value[valuelen] = '\0';
+        } else {
+            const size_t notice_len = sizeof(long_value_notice) - 1;
+            this->serial = (notice_len << 24) | SERIAL_LONG_FLAG;
+            memcpy(this->value, long_value_notice, notice_len + 1);
+            memcpy(this->name + namelen + 1, value, valuelen);
+            this->name[namelen + 1 + valuelen] = '\0';
+        }
         ANDROID_MEMBAR_FULL();
     }
+
+    const char *long_value() const {
+        return name + strlen(name) + 1;
+    }
 private:
     DISALLOW_COPY_AND_ASSIGN(prop_info);
 };
 
+/*
+ * Properties whose names start with certain prefixes can be kept in extra
+ * areas, each in its own file (the main area's file name, a '.', and the
+ * prefix) and of its own size. The main area lists them. Names and values
+ * in extra areas may be longer than in the main area: older versions of
+ * libc never look in the extra areas, so they can't be confused by them.
+ */
+struct prop_area_link {
+    volatile uint32_t next;
+    uint32_t size;
+    char prefix[0];
+
+private:
+    DISALLOW_COPY_AND_ASSIGN(prop_area_link);
+};
+
+#define PROP_AREAS_MAX 8
+
+// A mapped property area.
+struct prop_area_map {
+    prop_area *pa;
+    size_t data_size;
+};
+
 struct find_nth_cookie {
     uint32_t count;
     const uint32_t n;
@@ -170,12 +226,36 @@ static int get_fd_from_env(void)
     return atoi(env);
 }
 
-static int map_prop_area_rw()
+/*
+ * Besides the trie, which older versions of libc read, each area has an index
+ * of its properties: a hash table of prop_info offsets, open addressed with
+ * linear probing. Lookups use it instead of the trie, so they cost a hash and
+ * usually a probe or two, rather than a string compare for every node on the
+ * way down binary trees that insertion order can make arbitrarily lopsided.
+ * The index lives past the space properties are allocated from, and has one
+ * slot per PROP_INDEX_BYTES_PER_SLOT bytes of that, which keeps it under half
+ * full. The writer adds each new property to it once the property is complete.
+ * An index of 0 means there isn't one (the area was made by an older init).
+ */
+#define PROP_INDEX_BYTES_PER_SLOT 64
+
+static size_t index_slots(const size_t size)
+{
+    size_t slots = 1;
+    while (slots < size / PROP_INDEX_BYTES_PER_SLOT) {
+        slots <<= 1;
+    }
+    return slots;
+}
+
+// Creates and maps a new, empty property area with room for 'size' bytes of
+// properties (and an index for them).
+static int create_prop_area(const char *filename, const size_t size, prop_area_map *area)
 {
     /* dev is a tmpfs that we can use to carve a shared workspace
      * out of, so let's do that...
      */
-    const int fd = open(property_filename,
+    const int fd = open(filename,
                         O_RDWR | O_CREAT | O_NOFOLLOW | O_CLOEXEC | O_EXCL, 0444);
 
     if (fd < 0) {
@@ -196,31 +276,46 @@ static int map_prop_area_rw()
         return -1;
     }
 
-    if (ftruncate(fd, PA_SIZE) < 0) {
+    const size_t slots = index_slots(size);
+    const size_t mapped_size = size + slots * sizeof(uint32_t);
+    if (ftruncate(fd, mapped_size) < 0) {
         close(fd);
         return -1;
     }
 
-    pa_size = PA_SIZE;
-    pa_data_size = pa_size - sizeof(prop_area);
-    compat_mode = false;
-
-    void *const memory_area = mmap(NULL, pa_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    void *const memory_area = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
     if (memory_area == MAP_FAILED) {
         close(fd);
         return -1;
     }
 
     prop_area *pa = new(memory_area) prop_area(PROP_AREA_MAGIC, PROP_AREA_VERSION);
-
-    /* plug into the lib property services */
-    __system_property_area__ = pa;
+    pa->index = size - sizeof(prop_area);
+    pa->index_mask = slots - 1;
+    area->pa = pa;
+    area->data_size = mapped_size - sizeof(prop_area);
 
     close(fd);
     return 0;
 }
 
-static int map_fd_ro(const int fd) {
+static int map_prop_area_rw()
+{
+    prop_area_map area;
+    if (create_prop_area(property_filename, PA_SIZE, &area) < 0) {
+        return -1;
+    }
+
+    pa_size = area.data_size + sizeof(prop_area);
+    pa_data_size = area.data_size;
+    compat_mode = false;
+
+    /* plug into the lib property services */
+    __system_property_area__ = area.pa;
+    return 0;
+}
+
+static int map_fd_ro_area(const int fd, prop_area_map *area) {
     struct stat fd_stat;
     if (fstat(fd, &fd_stat) < 0) {
         return -1;
@@ -233,10 +328,7 @@ static int map_fd_ro(const int fd) {
         return -1;
     }
 
-    pa_size = fd_stat.st_size;
-    pa_data_size = pa_size - sizeof(prop_area);
-
-    void* const map_result = mmap(NULL, pa_size, PROT_READ, MAP_SHARED, fd, 0);
+    void* const map_result = mmap(NULL, fd_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
     if (map_result == MAP_FAILED) {
         return -1;
     }
@@ -244,15 +336,29 @@ static int map_fd_ro(const int fd) {
     prop_area* pa = reinterpret_cast<prop_area*>(map_result);
     if ((pa->magic != PROP_AREA_MAGIC) || (pa->version != PROP_AREA_VERSION &&
                 pa->version != PROP_AREA_VERSION_COMPAT)) {
-        munmap(pa, pa_size);
+        munmap(pa, fd_stat.st_size);
+        return -1;
+    }
+
+    area->pa = pa;
+    area->data_size = fd_stat.st_size - sizeof(prop_area);
+    return 0;
+}
+
+static int map_fd_ro(const int fd) {
+    prop_area_map area;
+    if (map_fd_ro_area(fd, &area) < 0) {
         return -1;
     }
 
-    if (pa->version == PROP_AREA_VERSION_COMPAT) {
+    pa_size = area.data_size + sizeof(prop_area);
+    pa_data_size = area.data_size;
+
+    if (area.pa->version == PROP_AREA_VERSION_COMPAT) {
         compat_mode = true;
     }
 
-    __system_property_area__ = pa;
+    __system_property_area__ = area.pa;
     return 0;
 }
 
@@ -295,11 +401,12 @@ static int map_prop_area()
     return map_result;
 }
 
-static void *allocate_obj(const size_t size, uint32_t *const off)
+static void *allocate_obj(const prop_area_map &area, const size_t size, uint32_t *const off)
 {
-    prop_area *pa = __system_property_area__;
+    prop_area *pa = area.pa;
     const size_t aligned = BIONIC_ALIGN(size, sizeof(uint32_t));
-    if (pa->bytes_used + aligned > pa_data_size) {
+    const size_t limit = (pa->index != 0) ? pa->index : area.data_size;
+    if (pa->bytes_used + aligned > limit) {
         return NULL;
     }
 
@@ -308,10 +415,11 @@ static void *allocate_obj(const size_t size, uint32_t *const off)
     return pa->data + *off;
 }
 
-static prop_bt *new_prop_bt(const char *name, uint8_t namelen, uint32_t *const off)
+static prop_bt *new_prop_bt(const prop_area_map &area, const char *name, uint8_t namelen,
+                            uint32_t *const off)
 {
     uint32_t new_offset;
-    void *const offset = allocate_obj(sizeof(prop_bt) + namelen + 1, &new_offset);
+    void *const offset = allocate_obj(area, sizeof(prop_bt) + namelen + 1, &new_offset);
     if (offset) {
         prop_bt* bt = new(offset) prop_bt(name, namelen);
         *off = new_offset;
@@ -321,11 +429,16 @@ static prop_bt *new_prop_bt(const char *name, uint8_t namelen, uint32_t *const o
     return NULL;
 }
 
-static prop_info *new_prop_info(const char *name, uint8_t namelen,
-        const char *value, uint8_t valuelen, uint32_t *const off)
+static prop_info *new_prop_info(const prop_area_map &area, const char *name, size_t namelen,
+        const char *value, size_t valuelen, uint32_t *const off)
 {
+    size_t size = sizeof(prop_info) + namelen + 1;
+    if (valuelen >= PROP_VALUE_MAX) {
+        size += valuelen + 1;
+    }
+
     uint32_t off_tmp;
-    void* const offset = allocate_obj(sizeof(prop_info) + namelen + 1, &off_tmp);
+    void* const offset = allocate_obj(area, size, &off_tmp);
     if (offset) {
         prop_info* info = new(offset) prop_info(name, namelen, value, valuelen);
         *off = off_tmp;
@@ -335,19 +448,19 @@ static prop_info *new_prop_info(const char *name, uint8_t namelen,
     return NULL;
 }
 
-static void *to_prop_obj(const uint32_t off)
+static void *to_prop_obj(const prop_area_map &area, const uint32_t off)
 {
-    if (off > pa_data_size)
+    if (off > area.data_size)
         return NULL;
-    if (!__system_property_area__)
+    if (!area.pa)
         return NULL;
 
-    return (__system_property_area__->data + off);
+    return (area.pa->data + off);
 }
 
-static prop_bt *root_node()
+static prop_bt *root_node(const prop_area_map &area)
 {
-    return reinterpret_cast<prop_bt*>(to_prop_obj(0));
+    return reinterpret_cast<prop_bt*>(to_prop_obj(area, 0));
 }
 
 static int cmp_prop_name(const char *one, uint8_t one_len, const char *two,
@@ -361,7 +474,7 @@ static int cmp_prop_name(const char *one, uint8_t one_len, const char *two,
         return strncmp(one, two, one_len);
 }
 
-static prop_bt *find_prop_bt(prop_bt *const bt, const char *name,
+static prop_bt *find_prop_bt(const prop_area_map &area, prop_bt *const bt, const char *name,
                              uint8_t namelen, bool alloc_if_needed)
 {
 
@@ -378,7 +491,7 @@ static prop_bt *find_prop_bt(prop_bt *const bt, const char *name,
 
         if (ret < 0) {
             if (current->left) {
-                current = reinterpret_cast<prop_bt*>(to_prop_obj(current->left));
+                current = reinterpret_cast<prop_bt*>(to_prop_obj(area, current->left));
             } else {
                 if (!alloc_if_needed) {
                    return NULL;
@@ -389,7 +502,7 @@ static prop_bt *find_prop_bt(prop_bt *const bt, const char *name,
                 // that allocates new nodes. Though "bt->left" is volatile, it can't
                 // have changed since the last value was last read.
                 uint32_t new_offset = 0;
-                prop_bt* new_bt = new_prop_bt(name, namelen, &new_offset);
+                prop_bt* new_bt = new_prop_bt(area, name, namelen, &new_offset);
                 if (new_bt) {
                     current->left = new_offset;
                 }
@@ -397,14 +510,14 @@ static prop_bt *find_prop_bt(prop_bt *const bt, const char *name,
             }
         } else {
             if (current->right) {
-                current = reinterpret_cast<prop_bt*>(to_prop_obj(current->right));
+                current = reinterpret_cast<prop_bt*>(to_prop_obj(area, current->right));
             } else {
                 if (!alloc_if_needed) {
                    return NULL;
                 }
 
                 uint32_t new_offset;
-                prop_bt* new_bt = new_prop_bt(name, namelen, &new_offset);
+                prop_bt* new_bt = new_prop_bt(area, name, namelen, &new_offset);
                 if (new_bt) {
                     current->right = new_offset;
                 }
@@ -414,10 +527,84 @@ static prop_bt *find_prop_bt(prop_bt *const bt, const char *name,
     }
 }
 
-static const prop_info *find_property(prop_bt *const trie, const char *name,
-        uint8_t namelen, const char *value, uint8_t valuelen,
+static uint32_t hash_prop_name(const char *name, const size_t namelen)
+{
+    // FNV-1a.
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < namelen; ++i) {
+        hash = (hash ^ static_cast<uint8_t>(name[i])) * 16777619u;
+    }
+    return hash;
+}
+
+static volatile uint32_t *get_index(const prop_area_map &area)
+{
+    if (area.pa == NULL) {
+        return NULL;
+    }
+
+    const uint32_t index = area.pa->index;
+    const size_t index_size = (static_cast<size_t>(area.pa->index_mask) + 1) * sizeof(uint32_t);
+    if (index == 0 || index > area.data_size || index_size > area.data_size - index) {
+        return NULL;
+    }
+    return reinterpret_cast<volatile uint32_t*>(area.pa->data + index);
+}
+
+static void index_property(const prop_area_map &area, const char *name, size_t namelen,
+                           const uint32_t off)
+{
+    volatile uint32_t *index = get_index(area);
+    if (index == NULL) {
+        return;
+    }
+
+    const uint32_t mask = area.pa->index_mask;
+    uint32_t slot = hash_prop_name(name, namelen) & mask;
+    for (uint32_t probes = 0; probes <= mask; ++probes, slot = (slot + 1) & mask) {
+        if (index[slot] == 0) {
+            index[slot] = off;
+            return;
+        }
+    }
+
+    // The index is full, which its size should make impossible. Readers
+    // can still use the trie.
+    area.pa->index = 0;
+}
+
+// Looks 'name' up in the area's index. Returns false if there's no index.
+static bool find_indexed_property(const prop_area_map &area, const char *name,
+                                  const uint32_t hash, const prop_info **result)
+{
+    volatile uint32_t *index = get_index(area);
+    if (index == NULL) {
+        return false;
+    }
+
+    const uint32_t mask = area.pa->index_mask;
+    uint32_t slot = hash & mask;
+    for (uint32_t probes = 0; probes <= mask; ++probes, slot = (slot + 1) & mask) {
+        const uint32_t off = index[slot];
+        if (off == 0) {
+            break;
+        }
+        const prop_info *pi = reinterpret_cast<prop_info*>(to_prop_obj(area, off));
+        if (pi != NULL && strcmp(pi->name, name) == 0) {
+            *result = pi;
+            return true;
+        }
+    }
+
+    *result = NULL;
+    return true;
+}
+
+static const prop_info *find_property(const prop_area_map &area, const char *name,
+        size_t namelen, const char *value, size_t valuelen,
         bool alloc_if_needed)
 {
+    prop_bt *const trie = root_node(area);
     if (!trie) return NULL;
 
     const char *remaining_name = name;
@@ -434,10 +621,10 @@ static const prop_info *find_property(prop_bt *const trie, const char *name,
 
         prop_bt* root = NULL;
         if (current->children) {
-            root = reinterpret_cast<prop_bt*>(to_prop_obj(current->children));
+            root = reinterpret_cast<prop_bt*>(to_prop_obj(area, current->children));
         } else if (alloc_if_needed) {
             uint32_t new_bt_offset;
-            root = new_prop_bt(remaining_name, substr_size, &new_bt_offset);
+            root = new_prop_bt(area, remaining_name, substr_size, &new_bt_offset);
             if (root) {
                 current->children = new_bt_offset;
             }
@@ -447,7 +634,7 @@ static const prop_info *find_property(prop_bt *const trie, const char *name,
             return NULL;
         }
 
-        current = find_prop_bt(root, remaining_name, substr_size, alloc_if_needed);
+        current = find_prop_bt(area, root, remaining_name, substr_size, alloc_if_needed);
         if (!current) {
             return NULL;
         }
@@ -459,12 +646,14 @@ static const prop_info *find_property(prop_bt *const trie, const char *name,
     }
 
     if (current->prop) {
-        return reinterpret_cast<prop_info*>(to_prop_obj(current->prop));
+        return reinterpret_cast<prop_info*>(to_prop_obj(area, current->prop));
     } else if (alloc_if_needed) {
         uint32_t new_info_offset;
-        prop_info* new_info = new_prop_info(name, namelen, value, valuelen, &new_info_offset);
+        prop_info* new_info = new_prop_info(area, name, namelen, value, valuelen,
+                                            &new_info_offset);
         if (new_info) {
             current->prop = new_info_offset;
+            index_property(area, name, namelen, new_info_offset);
         }
 
         return new_info;
@@ -473,7 +662,100 @@ static const prop_info *find_property(prop_bt *const trie, const char *name,
     }
 }
 
-static int send_prop_msg(const prop_msg *msg)
+static prop_area_map main_area()
+{
+    prop_area_map area = { __system_property_area__, pa_data_size };
+    return area;
+}
+
+// The extra areas this process has mapped, in the main area's order, and the
+// main area they belong to (tests switch main areas).
+static prop_area_map extra_areas[PROP_AREAS_MAX];
+static prop_area *volatile extra_areas_main = NULL;
+static pthread_mutex_t extra_areas_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool extra_area_filename(const char *prefix, char *filename, size_t size)
+{
+    const int len = snprintf(filename, size, "%s.%s", property_filename, prefix);
+    return len >= 0 && static_cast<size_t>(len) < size;
+}
+
+// Returns the i'th extra area, which 'link' describes, mapping it if need be.
+static bool get_extra_area(size_t i, const prop_area_link *link, prop_area_map *result)
+{
+    prop_area *main_pa = __system_property_area__;
+    if (extra_areas_main == main_pa && extra_areas[i].pa != NULL) {
+        *result = extra_areas[i];
+        return true;
+    }
+
+    pthread_mutex_lock(&extra_areas_lock);
+    if (extra_areas_main != main_pa) {
+        memset(extra_areas, 0, sizeof(extra_areas));
+        extra_areas_main = main_pa;
+    }
+    if (extra_areas[i].pa == NULL) {
+        char filename[PATH_MAX];
+        const int fd = extra_area_filename(link->prefix, filename, sizeof(filename)) ?
+                open(filename, O_RDONLY | O_NOFOLLOW | O_CLOEXEC) : -1;
+        if (fd >= 0) {
+            prop_area_map area;
+            if (map_fd_ro_area(fd, &area) == 0) {
+                extra_areas[i].data_size = area.data_size;
+                ANDROID_MEMBAR_FULL();
+                extra_areas[i].pa = area.pa;
+            }
+            close(fd);
+        }
+    }
+    *result = extra_areas[i];
+    pthread_mutex_unlock(&extra_areas_lock);
+    return result->pa != NULL;
+}
+
+static const prop_area_link *get_area_link(const prop_area_map &main, uint32_t off)
+{
+    return reinterpret_cast<const prop_area_link*>(to_prop_obj(main, off));
+}
+
+// Finds the area that holds (or would hold) the property 'name': the extra
+// area with the longest prefix of 'name', or else the main area. Returns
+// whether it's an extra area.
+static bool area_for_name(const char *name, prop_area_map *result)
+{
+    const prop_area_map main = main_area();
+    *result = main;
+    if (main.pa == NULL) {
+        return false;
+    }
+
+    const prop_area_link *best = NULL;
+    size_t best_i = 0;
+    size_t best_len = 0;
+    uint32_t off = main.pa->areas;
+    for (size_t i = 0; off != 0 && i < PROP_AREAS_MAX; ++i) {
+        const prop_area_link *link = get_area_link(main, off);
+        if (link == NULL) {
+            break;
+        }
+        const size_t len = strlen(link->prefix);
+        if (len > best_len && strncmp(name, link->prefix, len) == 0) {
+            best = link;
+            best_i = i;
+            best_len = len;
+        }
+        off = link->next;
+    }
+    return best != NULL && get_extra_area(best_i, best, result);
+}
+
+static bool is_in_area(const prop_area_map &area, const void *p)
+{
+    const char *cp = reinterpret_cast<const char*>(p);
+    return area.pa != NULL && cp >= area.pa->data && cp < area.pa->data + area.data_size;
+}
+
+static int connect_to_property_service()
 {
     const int fd = socket(AF_LOCAL, SOCK_STREAM | SOCK_CLOEXEC, 0);
     if (fd == -1) {
@@ -492,6 +774,16 @@ static int send_prop_msg(const prop_msg *msg)
         return -1;
     }
 
+    return fd;
+}
+
+static int send_prop_msg(const prop_msg *msg)
+{
+    const int fd = connect_to_property_service();
+    if (fd == -1) {
+        return -1;
+    }
+
     const int num_bytes = TEMP_FAILURE_RETRY(send(fd, msg, sizeof(prop_msg), 0));
 
     int result = -1;
@@ -528,6 +820,27 @@ static int send_prop_msg(const prop_msg *msg)
     return result;
 }
 
+static bool send_fully(const int fd, const void *buf, size_t len)
+{
+    const char *p = reinterpret_cast<const char*>(buf);
+    while (len > 0) {
+        const ssize_t num_bytes = TEMP_FAILURE_RETRY(send(fd, p, len, MSG_NOSIGNAL));
+        if (num_bytes <= 0) {
+            return false;
+        }
+        p += num_bytes;
+        len -= num_bytes;
+    }
+    return true;
+}
+
+// How long to wait for the property service to acknowledge a batch. Unlike
+// a single set, there's a real answer to wait for, so this is generous.
+#define PROP_BATCH_TIMEOUT_MS 5000
+
+// How many messages to send at a time.
+#define PROP_BATCH_CHUNK 16
+
 static void find_nth_fn(const prop_info *pi, void *ptr)
 {
     find_nth_cookie *cookie = reinterpret_cast<find_nth_cookie*>(ptr);
@@ -538,31 +851,31 @@ static void find_nth_fn(const prop_info *pi, void *ptr)
     cookie->count++;
 }
 
-static int foreach_property(const uint32_t off,
+static int foreach_property(const prop_area_map &area, const uint32_t off,
         void (*propfn)(const prop_info *pi, void *cookie), void *cookie)
 {
-    prop_bt *trie = reinterpret_cast<prop_bt*>(to_prop_obj(off));
+    prop_bt *trie = reinterpret_cast<prop_bt*>(to_prop_obj(area, off));
     if (!trie)
         return -1;
 
     if (trie->left) {
-        const int err = foreach_property(trie->left, propfn, cookie);
+        const int err = foreach_property(area, trie->left, propfn, cookie);
         if (err < 0)
             return -1;
     }
     if (trie->prop) {
-        prop_info *info = reinterpret_cast<prop_info*>(to_prop_obj(trie->prop));
+        prop_info *info = reinterpret_cast<prop_info*>(to_prop_obj(area, trie->prop));
         if (!info)
             return -1;
         propfn(info, cookie);
     }
     if (trie->children) {
-        const int err = foreach_property(trie->children, propfn, cookie);
+        const int err = foreach_property(area, trie->children, propfn, cookie);
         if (err < 0)
             return -1;
     }
     if (trie->right) {
-        const int err = foreach_property(trie->right, propfn, cookie);
+        const int err = foreach_property(area, trie->right, propfn, cookie);
         if (err < 0)
             return -1;
     }
@@ -590,12 +903,59 @@ int __system_property_area_init()
     return map_prop_area_rw();
 }
 
+/*
+ * Finding a property's area and probing its index (or, for areas made by older
+ * versions of init, walking its trie) touches several cache lines, so remember
+ * where the properties this process has looked up are. The cache is
+ * direct-mapped by the same hash of the name as the index, and only holds
+ * properties that exist: they never move or go away, so the only thing to
+ * check on a hit is that the entry is from the current property area and that
+ * the name matches. The area has to be checked first: tests switch areas, and
+ * an entry from an old one may point into memory that's since been unmapped.
+ */
+#define FIND_CACHE_SIZE 1024
+
+static const prop_info* volatile find_cache[FIND_CACHE_SIZE];
+
+static bool is_in_prop_area(const prop_info *pi)
+{
+    if (is_in_area(main_area(), pi)) {
+        return true;
+    }
+    if (extra_areas_main != __system_property_area__) {
+        return false;
+    }
+    for (size_t i = 0; i < PROP_AREAS_MAX; ++i) {
+        if (is_in_area(extra_areas[i], pi)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 const prop_info *__system_property_find(const char *name)
 {
     if (__predict_false(compat_mode)) {
         return __system_property_find_compat(name);
     }
-    return find_property(root_node(), name, strlen(name), NULL, 0, false);
+
+    const size_t namelen = strlen(name);
+    const uint32_t hash = hash_prop_name(name, namelen);
+    const prop_info* volatile* slot = &find_cache[hash % FIND_CACHE_SIZE];
+    const prop_info *pi = *slot;
+    if (pi != NULL && is_in_prop_area(pi) && strcmp(pi->name, name) == 0) {
+        return pi;
+    }
+
+    prop_area_map area;
+    area_for_name(name, &area);
+    if (!find_indexed_property(area, name, hash, &pi)) {
+        pi = find_property(area, name, namelen, NULL, 0, false);
+    }
+    if (pi != NULL) {
+        *slot = pi;
+    }
+    return pi;
 }
 
 int __system_property_read(const prop_info *pi, char *name, char *value)
@@ -611,13 +971,45 @@ int __system_property_read(const prop_info *pi, char *name, char *value)
         ANDROID_MEMBAR_FULL();
         if (serial == pi->serial) {
             if (name != 0) {
-                strcpy(name, pi->name);
+                // Names in extra areas can be longer than the caller expects.
+                strlcpy(name, pi->name, PROP_NAME_MAX);
             }
             return len;
         }
     }
 }
 
+int __system_property_read_callback(const prop_info *pi,
+        void (*callback)(void *cookie, const char *name, const char *value, unsigned serial),
+        void *cookie)
+{
+    if (__predict_false(compat_mode)) {
+        char name[PROP_NAME_MAX];
+        char value[PROP_VALUE_MAX];
+        __system_property_read_compat(pi, name, value);
+        callback(cookie, name, value, 0);
+        return 0;
+    }
+
+    // Long values never change, so they can be passed on as they are.
+    const uint32_t serial = __system_property_serial(pi);
+    if (serial & SERIAL_LONG_FLAG) {
+        callback(cookie, pi->name, pi->long_value(), serial);
+        return 0;
+    }
+
+    while (true) {
+        const uint32_t serial = __system_property_serial(pi);
+        char value[PROP_VALUE_MAX];
+        memcpy(value, pi->value, SERIAL_VALUE_LEN(serial) + 1);
+        ANDROID_MEMBAR_FULL();
+        if (serial == pi->serial) {
+            callback(cookie, pi->name, value, serial);
+            return 0;
+        }
+    }
+}
+
 int __system_property_get(const char *name, char *value)
 {
     const prop_info *pi = __system_property_find(name);
@@ -630,6 +1022,42 @@ int __system_property_get(const char *name, char *value)
     }
 }
 
+const char *__system_property_handle_get(prop_handle *handle)
+{
+    prop_area *pa = __system_property_area__;
+    if (__predict_false(compat_mode) || pa == NULL) {
+        __system_property_get(handle->name, handle->value);
+        return handle->value;
+    }
+
+    bool found = false;
+    if (handle->pi == NULL || handle->area != pa) {
+        // The property didn't exist last time. Look again only if any
+        // property has been added or changed since then.
+        const uint32_t area_serial = pa->serial;
+        if (handle->area == pa && handle->serial == area_serial) {
+            return handle->value;
+        }
+        handle->area = pa;
+        handle->pi = __system_property_find(handle->name);
+        if (handle->pi == NULL) {
+            handle->serial = area_serial;
+            handle->value[0] = '\0';
+            return handle->value;
+        }
+        found = true;
+    }
+
+    // Reading the serial before the value means the copy is never older than
+    // the serial it's cached under.
+    const uint32_t serial = handle->pi->serial;
+    if (found || serial != handle->serial) {
+        __system_property_read(handle->pi, NULL, handle->value);
+        handle->serial = serial;
+    }
+    return handle->value;
+}
+
 int __system_property_set(const char *key, const char *value)
 {
     if (key == 0) return -1;
@@ -651,18 +1079,100 @@ int __system_property_set(const char *key, const char *value)
     return 0;
 }
 
+int __system_property_set_batch(const char *const *keys, const char *const *values,
+                                size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        if (keys[i] == 0) return -1;
+        if (strlen(keys[i]) >= PROP_NAME_MAX) return -1;
+        if (values[i] != 0 && strlen(values[i]) >= PROP_VALUE_MAX) return -1;
+    }
+
+    const int fd = connect_to_property_service();
+    if (fd == -1) {
+        return -1;
+    }
+
+    prop_msg msgs[PROP_BATCH_CHUNK];
+    size_t i = 0;
+    bool end_sent = false;
+    while (!end_sent) {
+        memset(msgs, 0, sizeof(msgs));
+        size_t n = 0;
+        for (; n < PROP_BATCH_CHUNK && i < count; ++n, ++i) {
+            msgs[n].cmd = PROP_MSG_SETPROP_BATCH;
+            strlcpy(msgs[n].name, keys[i], sizeof(msgs[n].name));
+            strlcpy(msgs[n].value, values[i] ? values[i] : "", sizeof(msgs[n].value));
+        }
+        if (n < PROP_BATCH_CHUNK) {
+            msgs[n++].cmd = PROP_MSG_BATCH_END;
+            end_sent = true;
+        }
+        if (!send_fully(fd, msgs, n * sizeof(prop_msg))) {
+            close(fd);
+            return -1;
+        }
+    }
+
+    // The property service replies with the number of properties it
+    // couldn't set. One that doesn't know about batches just closes the
+    // socket, which counts as a failure: nothing was set.
+    int32_t failures = -1;
+    char *reply = reinterpret_cast<char*>(&failures);
+    size_t received = 0;
+    while (received < sizeof(failures)) {
+        pollfd pollfds[1];
+        pollfds[0].fd = fd;
+        pollfds[0].events = POLLIN;
+        const int poll_result = TEMP_FAILURE_RETRY(poll(pollfds, 1, PROP_BATCH_TIMEOUT_MS));
+        if (poll_result != 1) {
+            close(fd);
+            if (poll_result == 0) {
+                errno = ETIMEDOUT;
+            }
+            return -1;
+        }
+        const ssize_t num_bytes = TEMP_FAILURE_RETRY(
+                recv(fd, reply + received, sizeof(failures) - received, 0));
+        if (num_bytes <= 0) {
+            close(fd);
+            return -1;
+        }
+        received += num_bytes;
+    }
+
+    close(fd);
+    return (failures == 0) ? 0 : -1;
+}
+
+int __system_property_set_service_socket(const char *name)
+{
+    if (strlen(name) >= sizeof(property_service_socket)) {
+        return -1;
+    }
+
+    strcpy(property_service_socket, name);
+    return 0;
+}
+
 int __system_property_update(prop_info *pi, const char *value, unsigned int len)
 {
     prop_area *pa = __system_property_area__;
 
     if (len >= PROP_VALUE_MAX)
         return -1;
+    if (pi->serial & SERIAL_LONG_FLAG)
+        return -1;
 
     pi->serial = pi->serial | 1;
     ANDROID_MEMBAR_FULL();
     memcpy(pi->value, value, len + 1);
     ANDROID_MEMBAR_FULL();
-    pi->serial = (len << 24) | ((pi->serial + 1) & 0xffffff);
+    uint32_t count = (pi->serial + 1) & 0xffffff;
+    if (count & SERIAL_LONG_FLAG) {
+        count = (count + SERIAL_LONG_FLAG) & 0xffffff;
+    }
+    pi->serial = (len << 24) | count;
     __futex_wake(&pi->serial, INT32_MAX);
 
     pa->serial++;
@@ -677,14 +1187,16 @@ int __system_property_add(const char *name, unsigned int namelen,
     prop_area *pa = __system_property_area__;
     const prop_info *pi;
 
-    if (namelen >= PROP_NAME_MAX)
+    prop_area_map area;
+    const bool extra = area_for_name(name, &area);
+    if (namelen >= (extra ? PROP_NAME_MAX_LONG : PROP_NAME_MAX))
         return -1;
-    if (valuelen >= PROP_VALUE_MAX)
+    if (valuelen >= (extra ? PROP_VALUE_MAX_LONG : PROP_VALUE_MAX))
         return -1;
     if (namelen < 1)
         return -1;
 
-    pi = find_property(root_node(), name, namelen, value, valuelen, true);
+    pi = find_property(area, name, namelen, value, valuelen, true);
     if (!pi)
         return -1;
 
@@ -714,6 +1226,53 @@ unsigned int __system_property_wait_any(unsigned int serial)
     return pa->serial;
 }
 
+int __system_property_wait(const prop_info *pi, unsigned int old_serial,
+                           unsigned int *new_serial_ptr, const struct timespec *relative_timeout)
+{
+    prop_area *pa = __system_property_area__;
+    if (pa == NULL) {
+        return 0;
+    }
+
+    // The old layout's prop_info has its serial in a different place, so
+    // compat mode has to make do with waiting for any change.
+    const bool any = (pi == NULL) || __predict_false(compat_mode);
+    volatile uint32_t *serial_ptr =
+            any ? &pa->serial : const_cast<volatile uint32_t*>(&pi->serial);
+
+    timespec deadline;
+    if (relative_timeout != NULL) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += relative_timeout->tv_sec;
+        deadline.tv_nsec += relative_timeout->tv_nsec;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    uint32_t serial;
+    while ((serial = *serial_ptr) == old_serial) {
+        timespec remaining;
+        if (relative_timeout != NULL) {
+            clock_gettime(CLOCK_MONOTONIC, &remaining);
+            remaining.tv_sec = deadline.tv_sec - remaining.tv_sec;
+            remaining.tv_nsec = deadline.tv_nsec - remaining.tv_nsec;
+            if (remaining.tv_nsec < 0) {
+                remaining.tv_sec--;
+                remaining.tv_nsec += 1000000000;
+            }
+            if (remaining.tv_sec < 0) {
+                return 0;
+            }
+        }
+        __futex_wait(serial_ptr, serial, (relative_timeout != NULL) ? &remaining : NULL);
+    }
+
+    *new_serial_ptr = any ? serial : __system_property_serial(pi);
+    return 1;
+}
+
 const prop_info *__system_property_find_nth(unsigned n)
 {
     find_nth_cookie cookie(n);
@@ -733,5 +1292,85 @@ int __system_property_foreach(void (*propfn)(const prop_info *pi, void *cookie),
         return __system_property_foreach_compat(propfn, cookie);
     }
 
-    return foreach_property(0, propfn, cookie);
+    const prop_area_map main = main_area();
+    if (foreach_property(main, 0, propfn, cookie) < 0) {
+        return -1;
+    }
+
+    uint32_t off = main.pa->areas;
+    for (size_t i = 0; off != 0 && i < PROP_AREAS_MAX; ++i) {
+        const prop_area_link *link = get_area_link(main, off);
+        if (link == NULL) {
+            return -1;
+        }
+        // An area that can't be mapped (perhaps because of its permissions)
+        // is skipped rather than failing the whole walk.
+        prop_area_map area;
+        if (get_extra_area(i, link, &area) && foreach_property(area, 0, propfn, cookie) < 0) {
+            return -1;
+        }
+        off = link->next;
+    }
+    return 0;
+}
+
+int __system_property_add_area(const char *prefix, size_t size)
+{
+    const prop_area_map main = main_area();
+    if (main.pa == NULL || compat_mode) {
+        return -1;
+    }
+
+    const size_t prefix_len = strlen(prefix);
+    if (prefix_len < 1 || prefix_len >= PROP_NAME_MAX || strchr(prefix, '/') != NULL) {
+        return -1;
+    }
+    if (size < sizeof(prop_area) + sizeof(prop_bt) || size > UINT32_MAX) {
+        return -1;
+    }
+
+    // Find the end of the list, checking the prefix isn't already there.
+    volatile uint32_t *next = &main.pa->areas;
+    size_t i = 0;
+    for (; *next != 0; ++i) {
+        prop_area_link *link = reinterpret_cast<prop_area_link*>(to_prop_obj(main, *next));
+        if (link == NULL || i + 1 >= PROP_AREAS_MAX || strcmp(link->prefix, prefix) == 0) {
+            return -1;
+        }
+        next = &link->next;
+    }
+
+    char filename[PATH_MAX];
+    prop_area_map area;
+    if (!extra_area_filename(prefix, filename, sizeof(filename)) ||
+            create_prop_area(filename, size, &area) < 0) {
+        return -1;
+    }
+
+    uint32_t off;
+    prop_area_link *link = reinterpret_cast<prop_area_link*>(
+            allocate_obj(main, sizeof(prop_area_link) + prefix_len + 1, &off));
+    if (link == NULL) {
+        munmap(area.pa, size);
+        unlink(filename);
+        return -1;
+    }
+    link->next = 0;
+    link->size = size;
+    memcpy(link->prefix, prefix, prefix_len + 1);
+
+    pthread_mutex_lock(&extra_areas_lock);
+    if (extra_areas_main != main.pa) {
+        memset(extra_areas, 0, sizeof(extra_areas));
+        extra_areas_main = main.pa;
+    }
+    extra_areas[i] = area;
+    pthread_mutex_unlock(&extra_areas_lock);
+
+    ANDROID_MEMBAR_FULL();
+    *next = off;
+
+    main.pa->serial++;
+    __futex_wake(&main.pa->serial, INT32_MAX);
+    return 0;
 }
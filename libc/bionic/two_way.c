@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * The Two-Way string matching algorithm, from Crochemore and Perrin,
+ * "Two-way string-matching", Journal of the ACM 38(3), 1991.
+ *
+ * The needle is split at a "critical factorization" into a left and a right
+ * half. Each attempt compares the right half left to right, then the left half
+ * right to left; the factorization guarantees that a mismatch in the right half
+ * lets us shift past everything compared, and one in the left half lets us
+ * shift by the needle's period, so no haystack byte is looked at more than
+ * twice. Like glibc and musl we also skip ahead on the haystack byte under the
+ * needle's last byte, which makes most searches sublinear in practice.
+ */
+
+#include "two_way.h"
+
+#include <string.h>
+#include <sys/param.h>
+
+/*
+ * Finds the maximal suffix of the needle under the byte order (or its
+ * reverse, if reverse_order is set). Returns the index of the last byte
+ * before that suffix (which may be (size_t) -1), and stores the suffix's
+ * period in *period.
+ */
+static size_t maximal_suffix(const unsigned char* n, size_t n_len, int reverse_order,
+                             size_t* period) {
+  size_t i = (size_t) -1; /* Start of the best suffix so far, less one. */
+  size_t j = 0;           /* Start of the suffix being compared with it, less one. */
+  size_t k = 1;           /* Offset into both. */
+  size_t p = 1;           /* Period of the best suffix so far. */
+  while (j + k < n_len) {
+    unsigned char a = n[i + k];
+    unsigned char b = n[j + k];
+    if (a == b) {
+      if (k == p) {
+        j += p;
+        k = 1;
+      } else {
+        ++k;
+      }
+    } else if (reverse_order ? (a < b) : (a > b)) {
+      j += k;
+      k = 1;
+      p = j - i;
+    } else {
+      i = j++;
+      k = p = 1;
+    }
+  }
+  *period = p;
+  return i;
+}
+
+const unsigned char* __two_way_search(const unsigned char* h, const unsigned char* h_end,
+                                      const unsigned char* n, size_t n_len,
+                                      int nul_terminated) {
+  /* For each byte in the needle, one more than the index of its last occurrence. */
+  size_t shift[256];
+  unsigned long present[256 / (8 * sizeof(unsigned long))];
+  memset(present, 0, sizeof(present));
+  for (size_t i = 0; i < n_len; ++i) {
+    present[n[i] / (8 * sizeof(unsigned long))] |= 1UL << (n[i] % (8 * sizeof(unsigned long)));
+    shift[n[i]] = i + 1;
+  }
+
+  /* The critical factorization is the later of the two maximal suffixes. */
+  size_t period, reverse_period;
+  size_t split = maximal_suffix(n, n_len, 0, &period);
+  size_t reverse_split = maximal_suffix(n, n_len, 1, &reverse_period);
+  if (reverse_split + 1 > split + 1) {
+    split = reverse_split;
+    period = reverse_period;
+  }
+
+  /*
+   * If the left half recurs one period later, the needle is periodic: after a
+   * full match of the right half and a mismatch in the left, the first
+   * n_len - period bytes are known to match at the next attempt. Otherwise
+   * there's nothing to remember, and we can shift further.
+   */
+  size_t memory_after_shift;
+  if (memcmp(n, n + period, split + 1) == 0) {
+    memory_after_shift = n_len - period;
+  } else {
+    memory_after_shift = 0;
+    period = MAX(split, n_len - split - 1) + 1;
+  }
+  size_t memory = 0;
+
+  for (;;) {
+    if ((size_t) (h_end - h) < n_len) {
+      if (!nul_terminated) {
+        return NULL;
+      }
+      /* Look for the terminator at least a needle's length at a time. */
+      h_end += strnlen((const char*) h_end, n_len | 63);
+      if ((size_t) (h_end - h) < n_len) {
+        return NULL;
+      }
+    }
+
+    /* Shift so that the last haystack byte lines up with its last occurrence in the needle. */
+    unsigned char last = h[n_len - 1];
+    if ((present[last / (8 * sizeof(unsigned long))] & (1UL << (last % (8 * sizeof(unsigned long))))) == 0) {
+      h += n_len;
+      memory = 0;
+      continue;
+    }
+    size_t k = n_len - shift[last];
+    if (k != 0) {
+      /*
+       * memory != 0 means the last attempt matched the whole right half and
+       * shifted by the period, so the needle is periodic and its first
+       * `memory` (n_len - period) bytes are known to match here. The last byte
+       * doesn't fit that period, so if the skip for it is less than a period,
+       * shift by `memory` instead.
+       */
+      if (memory != 0 && k < period) {
+        k = memory;
+      }
+      h += k;
+      memory = 0;
+      continue;
+    }
+
+    /* Compare the right half. */
+    for (k = MAX(split + 1, memory); k < n_len && n[k] == h[k]; ++k) {
+    }
+    if (k < n_len) {
+      h += k - split;
+      memory = 0;
+      continue;
+    }
+
+    /* Compare the left half. */
+    for (k = split + 1; k > memory && n[k - 1] == h[k - 1]; --k) {
+    }
+    if (k <= memory) {
+      return h;
+    }
+    h += period;
+    memory = memory_after_shift;
+  }
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+#ifndef LIBC_TWO_WAY_H
+#define LIBC_TWO_WAY_H
+
+#include <stddef.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+/*
+ * Returns the first occurrence of the needle n[0..n_len) at or after h, or
+ * NULL. n_len must be at least 1. Runs in time linear in the length of the
+ * haystack, whatever the needle.
+ *
+ * If nul_terminated is 0, the haystack is [h, h_end). Otherwise it runs to the
+ * first NUL, and h_end is only how far it's already known not to contain one;
+ * the rest is found as the search goes, so that strstr needn't strlen.
+ */
+__LIBC_HIDDEN__ const unsigned char* __two_way_search(const unsigned char* h,
+                                                      const unsigned char* h_end,
+                                                      const unsigned char* n, size_t n_len,
+                                                      int nul_terminated);
+
+/*
+ * memmem and strstr first try a quick scan for the needle's first byte; this
+ * is how much more than the distance scanned they're allowed to spend
+ * checking candidates before switching to __two_way_search, and what each
+ * candidate costs on top of the bytes compared.
+ */
+#define TWO_WAY_SCAN_SLACK 256
+#define TWO_WAY_CANDIDATE_COST 16
+
+__END_DECLS
+
+#endif
@@ -24,6 +24,7 @@
  */
 #include <sys/cdefs.h>
 #include <stddef.h>
+#include <stdint.h>
 
 __BEGIN_DECLS
 
@@ -35,6 +36,14 @@ extern void free(void* p);
 extern void* memalign(size_t alignment, size_t byte_count) __mallocfunc __wur __attribute__((alloc_size(2)));
 extern size_t malloc_usable_size(const void* p);
 
+/*
+ * Like free, but the caller also passes the size it asked for (and for
+ * free_aligned_sized, the alignment), which saves the allocator looking the
+ * size up. Passing anything else is undefined.
+ */
+extern void free_sized(void* p, size_t byte_count);
+extern void free_aligned_sized(void* p, size_t alignment, size_t byte_count);
+
 #ifndef STRUCT_MALLINFO_DECLARED
 #define STRUCT_MALLINFO_DECLARED 1
 struct mallinfo {
@@ -53,6 +62,74 @@ struct mallinfo {
 
 extern struct mallinfo mallinfo(void);
 
+/*
+ * Returns free memory to the kernel, keeping up to pad bytes at the top of
+ * the heap. Returns 1 if any memory may have been released, and 0 otherwise.
+ */
+extern int malloc_trim(size_t pad);
+
+/* mallopt parameters. */
+#define M_TRIM_THRESHOLD (-1)  /* Free space at the top of the heap kept before trimming. */
+#define M_MMAP_THRESHOLD (-3)  /* Allocations at least this big get their own mapping. */
+#define M_DECAY_TIME (-100)    /* Seconds between background malloc_trim calls; 0 for never. */
+
+/* Sets the given parameter. Returns 1 on success and 0 on failure. */
+extern int mallopt(int param, int value);
+
+/*
+ * For in-process leak detectors and heap dumpers. malloc_disable stops all
+ * other threads from allocating or freeing until malloc_enable is called,
+ * and must not be called twice without malloc_enable in between. In between,
+ * malloc_iterate calls callback with the address and usable size of every
+ * allocation that starts in [base, base + size), which should be made up of
+ * whole "libc_malloc" mappings from /proc/self/maps. The calling thread may
+ * not allocate or free memory in between either, not even in the callback.
+ * malloc_iterate returns 0 on success, and -1 with errno set to ENOTSUP if
+ * the allocator can't be walked.
+ */
+extern int malloc_iterate(uintptr_t base, size_t size,
+                          void (*callback)(uintptr_t base, size_t size, void* arg), void* arg);
+extern void malloc_disable(void);
+extern void malloc_enable(void);
+
+/*
+ * Cheap allocation statistics, for watching memory use in production without
+ * walking the heap. These are only collected if the libc.malloc.stats system
+ * property (or the LIBC_MALLOC_STATS environment variable, which overrides it)
+ * was set to 1 when the process started; otherwise the functions below fail
+ * with ENOTSUP. If libc.malloc.stats.signal (or LIBC_MALLOC_STATS_SIGNAL) is
+ * also set, receiving that signal writes the statistics to stderr.
+ *
+ * Sizes are usable sizes (see malloc_usable_size). Size class 0 counts sizes
+ * of up to 16 bytes, each following class counts sizes of up to twice the
+ * previous class's limit, and the last class counts everything bigger. The
+ * counts and byte totals are cumulative and may wrap on 32-bit, but their
+ * differences (the live allocations and bytes) are still right.
+ */
+#define MALLOC_STATISTICS_SIZE_CLASSES 20
+
+struct malloc_size_class_statistics {
+  size_t max_size;         /* Largest usable size counted in this class. */
+  size_t allocations;      /* Number of allocations made. */
+  size_t frees;            /* Number of allocations freed. */
+  size_t allocated_bytes;  /* Bytes allocated. */
+  size_t freed_bytes;      /* Bytes freed. */
+};
+
+struct malloc_statistics {
+  size_t mapped_bytes;     /* Bytes obtained from the kernel. Subtract the live bytes for overhead. */
+  size_t allocations;      /* Totals over all the size classes. */
+  size_t frees;
+  size_t allocated_bytes;
+  size_t freed_bytes;
+  struct malloc_size_class_statistics classes[MALLOC_STATISTICS_SIZE_CLASSES];
+};
+
+/* Statistics for the whole process. */
+extern int malloc_get_statistics(struct malloc_statistics*);
+/* Statistics for allocations made and freed by the calling thread. */
+extern int malloc_get_thread_statistics(struct malloc_statistics*);
+
 __END_DECLS
 
 #endif  /* LIBC_INCLUDE_MALLOC_H_ */
@@ -324,6 +324,30 @@ int	 putc_unlocked(int, FILE *);
 int	 putchar_unlocked(int);
 #endif /* __POSIX_VISIBLE >= 199506 */
 
+#if __POSIX_VISIBLE >= 200809
+FILE	*fmemopen(void * __restrict, size_t, const char * __restrict);
+FILE	*open_memstream(char **, size_t *);
+#endif /* __POSIX_VISIBLE >= 200809 */
+
+#if __BSD_VISIBLE
+/*
+ * GNU extensions: versions of the other stdio functions that do not lock
+ * the FILE. The caller must hold the lock (see flockfile) or otherwise
+ * know that no other thread is using the FILE (see __fsetlocking).
+ */
+void	 clearerr_unlocked(FILE *);
+int	 feof_unlocked(FILE *);
+int	 ferror_unlocked(FILE *);
+int	 fileno_unlocked(FILE *);
+int	 fflush_unlocked(FILE *);
+int	 fgetc_unlocked(FILE *);
+char	*fgets_unlocked(char * __restrict, int, FILE * __restrict);
+int	 fputc_unlocked(int, FILE *);
+int	 fputs_unlocked(const char * __restrict, FILE * __restrict);
+size_t	 fread_unlocked(void * __restrict, size_t, size_t, FILE * __restrict);
+size_t	 fwrite_unlocked(const void * __restrict, size_t, size_t, FILE * __restrict);
+#endif /* __BSD_VISIBLE */
+
 #endif /* __BSD_VISIBLE || __POSIX_VISIBLE || __XPG_VISIBLE */
 
 /*
@@ -351,6 +375,24 @@ FILE	*funopen(const void *,
 
 #define	fropen(cookie, fn) funopen(cookie, fn, 0, 0, 0)
 #define	fwopen(cookie, fn) funopen(cookie, 0, fn, 0, 0)
+
+/*
+ * GNU stream interface. Unlike funopen, fopencookie takes a mode string
+ * and uses size_t lengths and 64-bit offsets.
+ */
+typedef ssize_t cookie_read_function_t(void *, char *, size_t);
+typedef ssize_t cookie_write_function_t(void *, const char *, size_t);
+typedef int cookie_seek_function_t(void *, off64_t *, int);
+typedef int cookie_close_function_t(void *);
+
+typedef struct {
+	cookie_read_function_t	*read;
+	cookie_write_function_t	*write;
+	cookie_seek_function_t	*seek;
+	cookie_close_function_t	*close;
+} cookie_io_functions_t;
+
+FILE	*fopencookie(void *, const char *, cookie_io_functions_t);
 #endif /* __BSD_VISIBLE */
 
 extern char* __fgets_chk(char*, int, FILE*, size_t);
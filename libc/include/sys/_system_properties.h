@@ -32,6 +32,7 @@
 #ifndef _REALLY_INCLUDE_SYS__SYSTEM_PROPERTIES_H_
 #error you should #include <sys/system_properties.h> instead
 #else
+#include <stddef.h>
 #include <sys/system_properties.h>
 
 typedef struct prop_msg prop_msg;
@@ -45,6 +46,10 @@ typedef struct prop_msg prop_msg;
 
 #define PA_SIZE         (128 * 1024)
 
+/* Limits for properties in areas added by __system_property_add_area. */
+#define PROP_NAME_MAX_LONG   256
+#define PROP_VALUE_MAX_LONG  4096
+
 #define SERIAL_VALUE_LEN(serial) ((serial) >> 24)
 #define SERIAL_DIRTY(serial) ((serial) & 1)
 
@@ -58,6 +63,15 @@ struct prop_msg
 };
 
 #define PROP_MSG_SETPROP 1
+
+/*
+** A batch is any number of PROP_MSG_SETPROP_BATCH messages followed
+** by one PROP_MSG_BATCH_END, all over the same connection.  The
+** property service sets them all, in order, then replies with an
+** int32_t: the number of properties it couldn't set.
+*/
+#define PROP_MSG_SETPROP_BATCH 2
+#define PROP_MSG_BATCH_END 3
     
 /*
 ** Rules:
@@ -91,6 +105,12 @@ struct prop_msg
 */
 int __system_property_set_filename(const char *filename);
 
+/*
+** Talk to the property service over the named socket instead of
+** the usual one.  This method is for testing only.
+*/
+int __system_property_set_service_socket(const char *name);
+
 /*
 ** Initialize the area to be used to store properties.  Can
 ** only be done by a single process that has write access to
@@ -98,6 +118,17 @@ int __system_property_set_filename(const char *filename);
 */
 int __system_property_area_init();
 
+/* Add a separate area, 'size' bytes long, for the properties whose
+** names start with 'prefix'.  Properties in it may have names up to
+** PROP_NAME_MAX_LONG and values up to PROP_VALUE_MAX_LONG long, and
+** values too long for PROP_VALUE_MAX can't be updated.  Can only be
+** done by the process that initialized the property area, before
+** any property with that prefix is added.
+**
+** Returns 0 on success, -1 on error.
+*/
+int __system_property_add_area(const char *prefix, size_t size);
+
 /* Add a new system property.  Can only be done by a single
 ** process that has write access to the property area, and
 ** that process must handle sequencing to ensure the property
@@ -128,9 +159,26 @@ unsigned int __system_property_serial(const prop_info *pi);
 
 /* Wait for any system property to be updated.  Caller must pass
 ** in 0 the first time, and the previous return value on each
-** successive call. */
+** successive call.
+**
+** Every update to every property wakes every caller, so to watch
+** particular properties use __system_property_wait instead. */
 unsigned int __system_property_wait_any(unsigned int serial);
 
+/* Wait for the serial number of a system property returned by
+** __system_property_find to differ from old_serial, or for
+** relative_timeout to pass if it isn't NULL.  Only updates to that
+** property wake the caller.  If pi is NULL, wait for the property
+** area's serial number to change instead, as when any property is
+** added or updated; pass 0 the first time.
+**
+** Returns 1 and sets *new_serial_ptr on a change, and 0 on timeout.
+*/
+struct timespec;
+int __system_property_wait(const prop_info *pi, unsigned int old_serial,
+                           unsigned int *new_serial_ptr,
+                           const struct timespec *relative_timeout);
+
 /*  Compatibility functions to support using an old init with a new libc,
  ** mostly for the OTA updater binary.  These can be deleted once OTAs from
  ** a pre-K release no longer needed to be supported. */
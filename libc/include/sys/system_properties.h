@@ -30,6 +30,7 @@
 #define _INCLUDE_SYS_SYSTEM_PROPERTIES_H
 
 #include <sys/cdefs.h>
+#include <stddef.h>
 
 __BEGIN_DECLS
 
@@ -50,6 +51,18 @@ int __system_property_get(const char *name, char *value);
 **/
 int __system_property_set(const char *key, const char *value);
 
+/* Set count system properties, keys[i] to values[i], over a single
+** connection to the property service, and wait for it to confirm
+** they were all set.  This is much cheaper than count calls to
+** __system_property_set() for callers that set many properties.
+**
+** Returns 0 on success, or -1 if any property wasn't set, the
+** property service didn't answer in time, or it doesn't support
+** batches.  Properties may have been set even on failure.
+*/
+int __system_property_set_batch(const char *const *keys,
+                                const char *const *values, size_t count);
+
 /* Return a pointer to the system property named name, if it
 ** exists, or NULL if there is no such property.  Use 
 ** __system_property_read() to obtain the string value from
@@ -72,6 +85,44 @@ const prop_info *__system_property_find(const char *name);
 */
 int __system_property_read(const prop_info *pi, char *name, char *value);
 
+/* Pass the name, value and serial number of a system property to
+** the provided callback.  Unlike __system_property_read(), this
+** isn't limited to PROP_NAME_MAX and PROP_VALUE_MAX: properties in
+** extra areas can have longer names and values, and those values
+** can only be read this way (__system_property_read() returns a
+** placeholder).  The strings are only good until the callback returns.
+**
+** Returns 0 on success, -1 on error.
+*/
+int __system_property_read_callback(const prop_info *pi,
+        void (*callback)(void *cookie, const char *name, const char *value,
+                         unsigned serial),
+        void *cookie);
+
+/* A handle on one system property, for callers that check it very
+** often. Initialize it with PROP_HANDLE_INITIALIZER and don't touch
+** its fields.
+**
+** __system_property_handle_get returns the property's value (or ""
+** if it doesn't exist). The name is only looked up until the property
+** exists, and the value is only copied again when the property has
+** changed; otherwise this costs one load and compare. The returned
+** string belongs to the handle and is good until the next call.
+**
+** Handles aren't thread-safe: use one per thread, or a lock.
+*/
+typedef struct prop_handle {
+    const char *name;
+    const void *area;
+    const prop_info *pi;
+    unsigned int serial;
+    char value[PROP_VALUE_MAX];
+} prop_handle;
+
+#define PROP_HANDLE_INITIALIZER(name) { (name), 0, 0, 0, { 0 } }
+
+const char *__system_property_handle_get(prop_handle *handle);
+
 /* Return a prop_info for the nth system property, or NULL if 
 ** there is no nth property.  Use __system_property_read() to
 ** read the value of this property.
@@ -79,10 +79,11 @@ enum {
 #define GLOBAL_INIT_THREAD_LOCAL_BUFFER_COUNT 5
 
 #if defined(USE_JEMALLOC)
-/* jemalloc uses 5 keys for itself. */
-#define BIONIC_TLS_RESERVED_SLOTS (GLOBAL_INIT_THREAD_LOCAL_BUFFER_COUNT + 5)
+/* jemalloc uses 5 keys for itself, and malloc statistics use 1. */
+#define BIONIC_TLS_RESERVED_SLOTS (GLOBAL_INIT_THREAD_LOCAL_BUFFER_COUNT + 6)
 #else
-#define BIONIC_TLS_RESERVED_SLOTS GLOBAL_INIT_THREAD_LOCAL_BUFFER_COUNT
+/* dlmalloc's thread cache uses 1 key, and malloc statistics use 1. */
+#define BIONIC_TLS_RESERVED_SLOTS (GLOBAL_INIT_THREAD_LOCAL_BUFFER_COUNT + 2)
 #endif
 
 /*
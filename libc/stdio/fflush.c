@@ -42,7 +42,9 @@ fflush(FILE *fp)
 	int	r;
 
 	if (fp == NULL)
-		return (_fwalk(__sflush_locked));
+		// BEGIN android-changed
+		return (_fwalk_output(__sflush_locked));
+		// END android-changed
 	FLOCKFILE(fp);
 	if ((fp->_flags & (__SWR | __SRW)) == 0) {
 		errno = EBADF;
@@ -53,6 +55,20 @@ fflush(FILE *fp)
 	return (r);
 }
 
+// BEGIN android-added
+int
+fflush_unlocked(FILE *fp)
+{
+	if (fp == NULL)
+		return (_fwalk_output(__sflush_locked));
+	if ((fp->_flags & (__SWR | __SRW)) == 0) {
+		errno = EBADF;
+		return (EOF);
+	}
+	return (__sflush(fp));
+}
+// END android-added
+
 int
 __sflush(FILE *fp)
 {
@@ -43,7 +43,7 @@
  * Do not return NULL if n == 1.
  */
 char *
-fgets(char *buf, int n, FILE *fp)
+fgets_unlocked(char *buf, int n, FILE *fp)
 {
 	size_t len;
 	char *s;
@@ -54,7 +54,6 @@ fgets(char *buf, int n, FILE *fp)
 		return (NULL);
 	}
 
-	FLOCKFILE(fp);
 	_SET_ORIENTATION(fp, -1);
 	s = buf;
 	n--;			/* leave space for NUL */
@@ -66,7 +65,6 @@ fgets(char *buf, int n, FILE *fp)
 			if (__srefill(fp)) {
 				/* EOF/error: stop with partial or no line */
 				if (s == buf) {
-					FUNLOCKFILE(fp);
 					return (NULL);
 				}
 				break;
@@ -81,7 +79,7 @@ fgets(char *buf, int n, FILE *fp)
 		 * newline, and stop.  Otherwise, copy entire chunk
 		 * and loop.
 		 */
-		if (len > n)
+		if (len > (size_t)n)
 			len = n;
 		t = memchr((void *)p, '\n', len);
 		if (t != NULL) {
@@ -90,7 +88,6 @@ fgets(char *buf, int n, FILE *fp)
 			fp->_p = t;
 			(void)memcpy((void *)s, (void *)p, len);
 			s[len] = '\0';
-			FUNLOCKFILE(fp);
 			return (buf);
 		}
 		fp->_r -= len;
@@ -100,6 +97,18 @@ fgets(char *buf, int n, FILE *fp)
 		n -= len;
 	}
 	*s = '\0';
-	FUNLOCKFILE(fp);
 	return (buf);
 }
+
+// BEGIN android-added
+char *
+fgets(char *buf, int n, FILE *fp)
+{
+	char *ret;
+
+	FLOCKFILE(fp);
+	ret = fgets_unlocked(buf, n, fp);
+	FUNLOCKFILE(fp);
+	return (ret);
+}
+// END android-added
@@ -43,9 +43,17 @@ struct __sfileext {
 	struct	__sbuf _ub; /* ungetc buffer */
 	struct wchar_io_data _wcio;	/* wide char io status */
 	pthread_mutex_t _lock; /* file lock */
+	int _seqreads; /* reads since the last seek, for readahead hints */
+	int _seqadvised; /* posix_fadvise(POSIX_FADV_SEQUENTIAL) already issued */
+	FILE *_freenext; /* next FILE on the free list (see findfp.c) */
+	int _onfreelist; /* currently on the free list */
+	FILE *_outnext; /* next FILE on the output list (see findfp.c) */
+	FILE *_outprev; /* previous FILE on the output list */
+	int _outlisted; /* currently on the output list */
+	int _caller_handles_locking; /* __fsetlocking(FSETLOCKING_BYCALLER) */
 };
 
-#define _FILEEXT_INITIALIZER  {{NULL,0},{0},PTHREAD_RECURSIVE_MUTEX_INITIALIZER}
+#define _FILEEXT_INITIALIZER  {{NULL,0},{0},PTHREAD_RECURSIVE_MUTEX_INITIALIZER,0,0,NULL,0,NULL,NULL,0,0}
 
 #define _EXT(fp) ((struct __sfileext *)((fp)->_ext._base))
 #define _UB(fp) _EXT(fp)->_ub
@@ -57,11 +65,24 @@ do { \
 	_UB(fp)._size = 0; \
 	WCIO_INIT(fp); \
         _FLOCK(fp).value = __PTHREAD_RECURSIVE_MUTEX_INIT_VALUE; \
+	_EXT(fp)->_seqreads = 0; \
+	_EXT(fp)->_seqadvised = 0; \
+	_EXT(fp)->_caller_handles_locking = 0; \
 } while (0)
 
+/*
+ * The list links are only reset here, not in _FILEEXT_INIT, because a
+ * concurrent _fwalk_output may still be following them after the FILE
+ * has been released and reused.
+ */
 #define _FILEEXT_SETUP(f, fext) \
 do { \
 	(f)->_ext._base = (unsigned char *)(fext); \
+	_EXT(f)->_freenext = NULL; \
+	_EXT(f)->_onfreelist = 0; \
+	_EXT(f)->_outnext = NULL; \
+	_EXT(f)->_outprev = NULL; \
+	_EXT(f)->_outlisted = 0; \
 	_FILEEXT_INIT(f); \
 } while (0)
 
@@ -50,7 +50,8 @@
 
 int	__sdidinit;
 
-#define	NDYNAMIC 10		/* add ten more whenever necessary */
+#define	NDYNAMIC 10		/* add ten more whenever necessary... */
+#define	NDYNAMIC_MAX 1024	/* ...doubling each time up to this many */
 
 #define	std(flags, file) \
 	{0,0,0,flags,file,{0},0,__sF+file,__sclose,__sread,__sseek,__swrite, \
@@ -61,8 +62,20 @@ static FILE usual[FOPEN_MAX - 3];
 static struct __sfileext usualext[FOPEN_MAX - 3];
 static struct glue uglue = { 0, FOPEN_MAX - 3, usual };
 static struct glue *lastglue = &uglue;
+static int nextglue = NDYNAMIC;
 _THREAD_PRIVATE_MUTEX(__sfp_mutex);
 
+/*
+ * Unused FILEs are kept on a free list so that __sfp need not scan the
+ * glue, and FILEs that may hold buffered output are kept on the output
+ * list so that flushing everything need not visit every slot. Both lists
+ * are only modified with __sfp_mutex held. The output list is walked
+ * without the lock: FILEs are never freed, and a FILE removed from the
+ * list keeps its _outnext, so a walker standing on it can carry on.
+ */
+static FILE *freelist;
+static FILE *outlist;
+
 static struct __sfileext __sFext[3];
 FILE __sF[3] = {
 	std(__SRD, STDIN_FILENO),		/* stdin */
@@ -117,20 +130,28 @@ __sfp(void)
 		__sinit();
 
 	_THREAD_PRIVATE_MUTEX_LOCK(__sfp_mutex);
-	for (g = &__sglue; g != NULL; g = g->next) {
-		for (fp = g->iobs, n = g->niobs; --n >= 0; fp++)
-			if (fp->_flags == 0)
-				goto found;
+	if ((fp = freelist) != NULL) {
+		freelist = _EXT(fp)->_freenext;
+		_EXT(fp)->_onfreelist = 0;
+		goto found;
 	}
 
 	/* release lock while mallocing */
+	n = nextglue;
 	_THREAD_PRIVATE_MUTEX_UNLOCK(__sfp_mutex);
-	if ((g = moreglue(NDYNAMIC)) == NULL)
+	if ((g = moreglue(n)) == NULL)
 		return (NULL);
 	_THREAD_PRIVATE_MUTEX_LOCK(__sfp_mutex);
 	lastglue->next = g;
 	lastglue = g;
-	fp = g->iobs;
+	if (nextglue < NDYNAMIC_MAX)
+		nextglue *= 2;
+	/* keep the first for ourselves; the rest go on the free list */
+	for (fp = g->iobs + n - 1; fp > g->iobs; fp--) {
+		_EXT(fp)->_freenext = freelist;
+		_EXT(fp)->_onfreelist = 1;
+		freelist = fp;
+	}
 found:
 	fp->_flags = 1;		/* reserve this slot; caller sets real flags */
 	_THREAD_PRIVATE_MUTEX_UNLOCK(__sfp_mutex);
@@ -148,6 +169,102 @@ found:
 	return (fp);
 }
 
+/*
+ * Release a FILE obtained from __sfp for reuse.
+ */
+void
+__sfprelease(FILE *fp)
+{
+	FILE *next, *prev;
+
+	_THREAD_PRIVATE_MUTEX_LOCK(__sfp_mutex);
+	if (_EXT(fp)->_outlisted) {
+		/* leave _outnext alone for the benefit of any walker */
+		next = _EXT(fp)->_outnext;
+		prev = _EXT(fp)->_outprev;
+		if (next != NULL)
+			_EXT(next)->_outprev = prev;
+		if (prev != NULL)
+			__atomic_store_n(&_EXT(prev)->_outnext, next, __ATOMIC_RELEASE);
+		else
+			__atomic_store_n(&outlist, next, __ATOMIC_RELEASE);
+		_EXT(fp)->_outlisted = 0;
+	}
+	fp->_flags = 0;
+	/*
+	 * stdin/stdout/stderr are not handed out again by __sfp: freopen
+	 * may resurrect them without going through __sfp. A failed freopen
+	 * of a closed FILE releases it again, so it may already be here.
+	 */
+	if ((fp < __sF || fp >= __sF + 3) && !_EXT(fp)->_onfreelist) {
+		_EXT(fp)->_freenext = freelist;
+		_EXT(fp)->_onfreelist = 1;
+		freelist = fp;
+	}
+	_THREAD_PRIVATE_MUTEX_UNLOCK(__sfp_mutex);
+}
+
+/*
+ * Take a released FILE back off the free list, for freopen of a closed
+ * stream, so that __sfp doesn't hand it out while it's in use again.
+ */
+void
+__sfpreclaim(FILE *fp)
+{
+	FILE **link;
+
+	_THREAD_PRIVATE_MUTEX_LOCK(__sfp_mutex);
+	if (_EXT(fp)->_onfreelist) {
+		for (link = &freelist; *link != fp; link = &_EXT(*link)->_freenext)
+			continue;
+		*link = _EXT(fp)->_freenext;
+		_EXT(fp)->_onfreelist = 0;
+	}
+	_THREAD_PRIVATE_MUTEX_UNLOCK(__sfp_mutex);
+}
+
+/*
+ * Put a FILE that is about to be given a write buffer on the output
+ * list. Called with the FILE locked.
+ */
+void
+__sfpoutput(FILE *fp)
+{
+	if (_EXT(fp)->_outlisted || (fp->_flags & __SSTR))
+		return;
+
+	_THREAD_PRIVATE_MUTEX_LOCK(__sfp_mutex);
+	if (_EXT(fp)->_outlisted) {
+		_THREAD_PRIVATE_MUTEX_UNLOCK(__sfp_mutex);
+		return;
+	}
+	_EXT(fp)->_outnext = outlist;
+	_EXT(fp)->_outprev = NULL;
+	if (outlist != NULL)
+		_EXT(outlist)->_outprev = fp;
+	__atomic_store_n(&outlist, fp, __ATOMIC_RELEASE);
+	_EXT(fp)->_outlisted = 1;
+	_THREAD_PRIVATE_MUTEX_UNLOCK(__sfp_mutex);
+}
+
+/*
+ * Like _fwalk, but only visits FILEs that may have buffered output.
+ */
+int
+_fwalk_output(int (*function)(FILE *))
+{
+	FILE *fp;
+	int ret;
+
+	ret = 0;
+	for (fp = __atomic_load_n(&outlist, __ATOMIC_ACQUIRE); fp != NULL;
+	    fp = __atomic_load_n(&_EXT(fp)->_outnext, __ATOMIC_ACQUIRE)) {
+		if ((fp->_flags != 0) && ((fp->_flags & __SIGN) == 0))
+			ret |= (*function)(fp);
+	}
+	return (ret);
+}
+
 /*
  * exit() and abort() call _cleanup() through the callback registered
  * with __atexit_register_cleanup(), set whenever we open or buffer a
@@ -160,7 +277,7 @@ void
 _cleanup(void)
 {
 	/* (void) _fwalk(fclose); */
-	(void) _fwalk(__sflush);		/* `cheating' */
+	(void) _fwalk_output(__sflush);		/* `cheating' */
 }
 
 /*
@@ -186,6 +303,13 @@ __sinit(void)
 	for (size_t i = 0; i < FOPEN_MAX - 3; ++i) {
 		_FILEEXT_SETUP(usual+i, usualext+i);
 	}
+	_THREAD_PRIVATE_MUTEX_LOCK(__sfp_mutex);
+	for (size_t i = FOPEN_MAX - 3; i > 0; --i) {
+		_EXT(usual+i-1)->_freenext = freelist;
+		_EXT(usual+i-1)->_onfreelist = 1;
+		freelist = usual+i-1;
+	}
+	_THREAD_PRIVATE_MUTEX_UNLOCK(__sfp_mutex);
 
 	/* make sure we clean up on exit */
 	__atexit_register_cleanup(_cleanup); /* conservative */
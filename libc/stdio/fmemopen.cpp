@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "local.h"
+
+// fmemopen and open_memstream FILEs don't have a buffer of their own. Instead
+// the FILE's buffer is a window onto the memory region starting at the current
+// position, so getc/putc/fread/fwrite/printf read and write the caller's memory
+// directly. The read and write functions are only called when stdio thinks its
+// buffer needs refilling or flushing; at that point the data is already in
+// place, so all they do is move the window along.
+//
+// If the caller replaces the buffer with setvbuf, or stdio bypasses the buffer
+// for a large transfer, the functions fall back to copying.
+//
+// Append streams always write at the end of the data, wherever the caller has
+// seeked to, so outside a read their window starts there rather than at pos.
+
+struct memfile {
+  FILE* fp;
+  char* buf;
+  size_t pos;    // Current position in buf.
+  size_t len;    // Length of the data in buf.
+  size_t limit;  // How far writes may go; one byte is kept for the NUL where one is written.
+  size_t capacity;
+  char* window;  // The buffer we last gave stdio.
+  bool append;
+  bool owns_buf;
+  // open_memstream only.
+  char** bufp;
+  size_t* sizep;
+  // Used when the window would be empty.
+  char scratch[1];
+};
+
+static void memfile_set_window(memfile* m, bool reading) {
+  FILE* fp = m->fp;
+  if (reinterpret_cast<char*>(fp->_bf._base) != m->window) {
+    // Someone else's buffer (see setvbuf); leave it alone.
+    return;
+  }
+  size_t start = (m->append && !reading) ? m->len : m->pos;
+  size_t size;
+  if (start < m->limit) {
+    m->window = m->buf + start;
+    size = m->limit - start;
+  } else {
+    // A zero-sized buffer would make __swbuf write past the end, so give stdio
+    // a byte it can fill; flushing that reports ENOSPC.
+    m->window = m->scratch;
+    size = sizeof(m->scratch);
+  }
+  if (size > INT_MAX) {
+    size = INT_MAX;
+  }
+  fp->_bf._base = fp->_p = reinterpret_cast<unsigned char*>(m->window);
+  fp->_bf._size = size;
+  fp->_w = (fp->_flags & __SWR) ? size : 0;
+}
+
+static void memstream_update(memfile* m) {
+  *m->bufp = m->buf;
+  *m->sizep = (m->pos < m->len) ? m->pos : m->len;
+}
+
+// Grows an open_memstream buffer so that 'need' bytes plus the NUL fit.
+static bool memstream_grow(memfile* m, size_t need) {
+  if (need <= m->limit) {
+    return true;
+  }
+  size_t new_capacity = m->capacity * 2;
+  if (new_capacity < need + 1) {
+    new_capacity = need + 1;
+  }
+  char* new_buf = reinterpret_cast<char*>(realloc(m->buf, new_capacity));
+  if (new_buf == NULL) {
+    return false;
+  }
+  // Bytes past the end read as zero if the caller seeks past the end and writes.
+  memset(new_buf + m->capacity, 0, new_capacity - m->capacity);
+  if (m->window != m->scratch) {
+    char* new_window = new_buf + (m->window - m->buf);
+    FILE* fp = m->fp;
+    if (reinterpret_cast<char*>(fp->_bf._base) == m->window) {
+      fp->_p = reinterpret_cast<unsigned char*>(new_window) + (fp->_p - fp->_bf._base);
+      fp->_bf._base = reinterpret_cast<unsigned char*>(new_window);
+    }
+    m->window = new_window;
+  }
+  m->buf = new_buf;
+  m->capacity = new_capacity;
+  m->limit = new_capacity - 1;
+  return true;
+}
+
+static int memfile_read(void* cookie, char* p, int n) {
+  memfile* m = reinterpret_cast<memfile*>(cookie);
+  size_t available = (m->pos < m->len) ? m->len - m->pos : 0;
+
+  if (p == m->window && reinterpret_cast<char*>(m->fp->_bf._base) == m->window) {
+    // __srefill: hand stdio the data where it already is.
+    if (available == 0) {
+      // At EOF; a write may follow without a seek, so point the window at
+      // where it should go rather than at the data just read.
+      memfile_set_window(m, false);
+      return 0;
+    }
+    memfile_set_window(m, true);
+    if (available > INT_MAX) {
+      available = INT_MAX;
+    }
+    m->pos += available;
+    return available;
+  }
+
+  if (available > static_cast<size_t>(n)) {
+    available = n;
+  }
+  memcpy(p, m->buf + m->pos, available);
+  m->pos += available;
+  return available;
+}
+
+static int memfile_write(void* cookie, const char* p, int n) {
+  memfile* m = reinterpret_cast<memfile*>(cookie);
+  if (m->append) {
+    m->pos = m->len;
+  }
+
+  // Remember where p is relative to buf in case open_memstream moves it.
+  ptrdiff_t offset = -1;
+  if (p >= m->buf && p < m->buf + m->capacity) {
+    offset = p - m->buf;
+  }
+
+  size_t count = n;
+  if (m->bufp != NULL) {
+    if (!memstream_grow(m, m->pos + count)) {
+      errno = ENOMEM;
+      return -1;
+    }
+  } else {
+    size_t room = (m->pos < m->limit) ? m->limit - m->pos : 0;
+    if (count > room) {
+      count = room;
+    }
+    if (count == 0) {
+      errno = ENOSPC;
+      return -1;
+    }
+  }
+
+  if (offset == -1) {
+    memcpy(m->buf + m->pos, p, count);
+  } else if (static_cast<size_t>(offset) != m->pos) {
+    memmove(m->buf + m->pos, m->buf + offset, count);
+  }
+  m->pos += count;
+  if (m->pos > m->len) {
+    m->len = m->pos;
+    if (m->len < m->capacity) {
+      m->buf[m->len] = '\0';
+    }
+  }
+
+  if (m->bufp != NULL) {
+    memstream_grow(m, m->pos + 1);
+    memstream_update(m);
+  }
+  memfile_set_window(m, false);
+  return count;
+}
+
+static fpos_t memfile_seek(void* cookie, fpos_t offset, int whence) {
+  memfile* m = reinterpret_cast<memfile*>(cookie);
+  fpos_t base;
+  if (whence == SEEK_SET) {
+    base = 0;
+  } else if (whence == SEEK_CUR) {
+    base = m->pos;
+  } else if (whence == SEEK_END) {
+    base = m->len;
+  } else {
+    errno = EINVAL;
+    return -1;
+  }
+  if ((offset < 0 && -offset > base) || (offset > 0 && offset > LONG_MAX - base)) {
+    errno = EINVAL;
+    return -1;
+  }
+  size_t new_pos = base + offset;
+  if (offset == 0 && whence == SEEK_CUR) {
+    // ftell; stdio doesn't expect the buffer to change.
+    return new_pos;
+  }
+
+  if (m->bufp != NULL) {
+    if (!memstream_grow(m, new_pos + 1)) {
+      errno = ENOMEM;
+      return -1;
+    }
+  } else if (new_pos > m->capacity) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  m->pos = new_pos;
+  if (m->bufp != NULL) {
+    memstream_update(m);
+  }
+  memfile_set_window(m, false);
+  return new_pos;
+}
+
+static int memfile_close(void* cookie) {
+  memfile* m = reinterpret_cast<memfile*>(cookie);
+  if (m->bufp != NULL) {
+    memstream_update(m);
+  }
+  if (m->owns_buf) {
+    free(m->buf);
+  }
+  free(m);
+  return 0;
+}
+
+static FILE* memfile_open(memfile* m, int flags) {
+  FILE* fp = __sfp();
+  if (fp == NULL) {
+    return NULL;
+  }
+  m->fp = fp;
+  m->window = m->scratch;
+  fp->_flags = flags | __SNPT;
+  fp->_file = -1;
+  fp->_cookie = m;
+  fp->_read = memfile_read;
+  fp->_write = memfile_write;
+  fp->_seek = memfile_seek;
+  fp->_close = memfile_close;
+  fp->_bf._base = reinterpret_cast<unsigned char*>(m->window);
+  memfile_set_window(m, false);
+  if (flags & (__SWR | __SRW)) {
+    __sfpoutput(fp);
+  }
+  return fp;
+}
+
+FILE* fmemopen(void* buf, size_t size, const char* mode) {
+  int oflags;
+  int flags = __sflags(mode, &oflags);
+  if (flags == 0) {
+    return NULL;
+  }
+  if (size == 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  memfile* m = reinterpret_cast<memfile*>(calloc(1, sizeof(memfile)));
+  if (m == NULL) {
+    return NULL;
+  }
+  if (buf == NULL) {
+    // POSIX allows a NULL buffer, in which case we allocate one that's freed on close.
+    m->buf = reinterpret_cast<char*>(calloc(1, size));
+    if (m->buf == NULL) {
+      free(m);
+      return NULL;
+    }
+    m->owns_buf = true;
+  } else {
+    m->buf = reinterpret_cast<char*>(buf);
+  }
+  m->capacity = m->limit = size;
+
+  if (oflags & (O_TRUNC | O_APPEND)) {
+    // POSIX: these modes write a NUL after the data, and the buffer is sized
+    // so that there's always room for it.
+    m->limit = size - 1;
+  }
+  if (oflags & O_TRUNC) {
+    m->buf[0] = '\0';
+  } else if (oflags & O_APPEND) {
+    // Append streams start (and write) at the first NUL.
+    char* nul = reinterpret_cast<char*>(memchr(m->buf, '\0', size));
+    m->pos = m->len = (nul != NULL) ? nul - m->buf : size;
+    m->append = true;
+  } else {
+    m->len = size;
+  }
+
+  FILE* fp = memfile_open(m, flags);
+  if (fp == NULL) {
+    memfile_close(m);
+  }
+  return fp;
+}
+
+FILE* open_memstream(char** bufp, size_t* sizep) {
+  if (bufp == NULL || sizep == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  memfile* m = reinterpret_cast<memfile*>(calloc(1, sizeof(memfile)));
+  if (m == NULL) {
+    return NULL;
+  }
+  m->capacity = BUFSIZ;
+  m->limit = m->capacity - 1;
+  m->buf = reinterpret_cast<char*>(calloc(1, m->capacity));
+  if (m->buf == NULL) {
+    free(m);
+    return NULL;
+  }
+  m->bufp = bufp;
+  m->sizep = sizep;
+  memstream_update(m);
+
+  FILE* fp = memfile_open(m, __SWR);
+  if (fp == NULL) {
+    free(m->buf);
+    free(m);
+  }
+  return fp;
+}
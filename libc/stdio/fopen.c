@@ -33,10 +33,12 @@
 #if defined(LIBC_SCCS) && !defined(lint)
 static char sccsid[] = "@(#)fopen.c	8.1 (Berkeley) 6/4/93";
 #endif /* LIBC_SCCS and not lint */
+
+#define __USE_BSD /* For DEFFILEMODE. */
+
 #include <sys/cdefs.h>
 __FBSDID("$FreeBSD$");
 
-#include "namespace.h"
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -44,7 +46,6 @@ __FBSDID("$FreeBSD$");
 #include <stdio.h>
 #include <errno.h>
 #include <limits.h>
-#include "un-namespace.h"
 
 #include "local.h"
 
@@ -59,8 +60,10 @@ fopen(const char * __restrict file, const char * __restrict mode)
 		return (NULL);
 	if ((fp = __sfp()) == NULL)
 		return (NULL);
-	if ((f = _open(file, oflags, DEFFILEMODE)) < 0) {
-		fp->_flags = 0;			/* release */
+	if ((f = open(file, oflags, DEFFILEMODE)) < 0) {
+		// BEGIN android-changed
+		__sfprelease(fp);		/* release */
+		// END android-changed
 		return (NULL);
 	}
 	/*
@@ -71,8 +74,10 @@ fopen(const char * __restrict file, const char * __restrict mode)
 	 * open.
 	 */
 	if (f > SHRT_MAX) {
-		fp->_flags = 0;			/* release */
-		_close(f);
+		// BEGIN android-changed
+		__sfprelease(fp);		/* release */
+		// END android-changed
+		close(f);
 		errno = EMFILE;
 		return (NULL);
 	}
@@ -92,6 +97,6 @@ fopen(const char * __restrict file, const char * __restrict mode)
 	 * fseek and ftell.)
 	 */
 	if (oflags & O_APPEND)
-		(void)_sseek(fp, (fpos_t)0, SEEK_END);
+		(void)__sseek(fp, (fpos_t)0, SEEK_END);
 	return (fp);
 }
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "local.h"
+
+// The funopen-style functions stdio calls take an int length and a cookie, so
+// we keep the caller's cookie and functions alongside each other and adapt.
+struct cookie_file {
+  void* cookie;
+  cookie_io_functions_t io;
+};
+
+static int cookie_read(void* cookie, char* p, int n) {
+  cookie_file* cf = reinterpret_cast<cookie_file*>(cookie);
+  // glibc reports EOF if there's no read function.
+  return (cf->io.read != NULL) ? cf->io.read(cf->cookie, p, n) : 0;
+}
+
+static int cookie_write(void* cookie, const char* p, int n) {
+  cookie_file* cf = reinterpret_cast<cookie_file*>(cookie);
+  // glibc silently discards output if there's no write function.
+  if (cf->io.write == NULL) {
+    return n;
+  }
+  return cf->io.write(cf->cookie, p, n);
+}
+
+static fpos_t cookie_seek(void* cookie, fpos_t offset, int whence) {
+  cookie_file* cf = reinterpret_cast<cookie_file*>(cookie);
+  off64_t offset64 = offset;
+  if (cf->io.seek(cf->cookie, &offset64, whence) != 0) {
+    return -1;
+  }
+  return offset64;
+}
+
+static int cookie_close(void* cookie) {
+  cookie_file* cf = reinterpret_cast<cookie_file*>(cookie);
+  int result = (cf->io.close != NULL) ? cf->io.close(cf->cookie) : 0;
+  free(cf);
+  return result;
+}
+
+FILE* fopencookie(void* cookie, const char* mode, cookie_io_functions_t io_funcs) {
+  int oflags;
+  int flags = __sflags(mode, &oflags);
+  if (flags == 0) {
+    return NULL;
+  }
+
+  cookie_file* cf = reinterpret_cast<cookie_file*>(malloc(sizeof(cookie_file)));
+  if (cf == NULL) {
+    return NULL;
+  }
+  cf->cookie = cookie;
+  cf->io = io_funcs;
+
+  FILE* fp = __sfp();
+  if (fp == NULL) {
+    free(cf);
+    return NULL;
+  }
+  fp->_flags = flags;
+  fp->_file = -1;
+  fp->_cookie = cf;
+  fp->_read = cookie_read;
+  fp->_write = cookie_write;
+  fp->_seek = (io_funcs.seek != NULL) ? cookie_seek : NULL;
+  fp->_close = cookie_close;
+
+  // As in fopen, start append streams at the end so ftell is right.
+  if ((oflags & O_APPEND) && fp->_seek != NULL) {
+    (void) cookie_seek(cf, 0, SEEK_END);
+  }
+  return fp;
+}
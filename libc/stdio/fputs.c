@@ -40,7 +40,7 @@
  * Write the given string to the given file.
  */
 int
-fputs(const char *s, FILE *fp)
+fputs_unlocked(const char *s, FILE *fp)
 {
 	struct __suio uio;
 	struct __siov iov;
@@ -50,9 +50,20 @@ fputs(const char *s, FILE *fp)
 	iov.iov_len = uio.uio_resid = strlen(s);
 	uio.uio_iov = &iov;
 	uio.uio_iovcnt = 1;
-	FLOCKFILE(fp);
 	_SET_ORIENTATION(fp, -1);
 	ret = __sfvwrite(fp, &uio);
+	return (ret);
+}
+
+// BEGIN android-added
+int
+fputs(const char *s, FILE *fp)
+{
+	int ret;
+
+	FLOCKFILE(fp);
+	ret = fputs_unlocked(s, fp);
 	FUNLOCKFILE(fp);
 	return (ret);
 }
+// END android-added
@@ -40,7 +40,7 @@
 #define MUL_NO_OVERFLOW	(1UL << (sizeof(size_t) * 4))
 
 size_t
-fread(void *buf, size_t size, size_t count, FILE *fp)
+fread_unlocked(void *buf, size_t size, size_t count, FILE *fp)
 {
 	size_t resid;
 	char *p;
@@ -62,7 +62,6 @@ fread(void *buf, size_t size, size_t count, FILE *fp)
 	 */
 	if ((resid = count * size) == 0)
 		return (0);
-	FLOCKFILE(fp);
 	_SET_ORIENTATION(fp, -1);
 	if (fp->_r < 0)
 		fp->_r = 0;
@@ -79,7 +78,6 @@ fread(void *buf, size_t size, size_t count, FILE *fp)
 			p += r;
 			resid -= r;
 		}
-		FUNLOCKFILE(fp);
 		return ((total - resid) / size);
 	}
 	// END android-added
@@ -92,13 +90,24 @@ fread(void *buf, size_t size, size_t count, FILE *fp)
 		resid -= r;
 		if (__srefill(fp)) {
 			/* no more input: return partial result */
-			FUNLOCKFILE(fp);
 			return ((total - resid) / size);
 		}
 	}
 	(void)memcpy((void *)p, (void *)fp->_p, resid);
 	fp->_r -= resid;
 	fp->_p += resid;
-	FUNLOCKFILE(fp);
 	return (count);
 }
+
+// BEGIN android-added
+size_t
+fread(void *buf, size_t size, size_t count, FILE *fp)
+{
+	size_t ret;
+
+	FLOCKFILE(fp);
+	ret = fread_unlocked(buf, size, count, fp);
+	FUNLOCKFILE(fp);
+	return (ret);
+}
+// END android-added
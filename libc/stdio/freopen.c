@@ -31,6 +31,8 @@
  * SUCH DAMAGE.
  */
 
+#define __USE_BSD /* For DEFFILEMODE. */
+
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -71,6 +73,9 @@ freopen(const char *file, const char *mode, FILE *fp)
 	 * should work.  This is unnecessary if it was not a Unix file.
 	 */
 	if (fp->_flags == 0) {
+		// BEGIN android-changed
+		__sfpreclaim(fp);	/* fclose put it on the free list */
+		// END android-changed
 		fp->_flags = __SEOF;	/* hold on to it */
 		isopen = 0;
 		wantfd = -1;
@@ -122,7 +127,9 @@ freopen(const char *file, const char *mode, FILE *fp)
 	fp->_lb._size = 0;
 
 	if (f < 0) {			/* did not get it after all */
-		fp->_flags = 0;		/* set it free */
+		// BEGIN android-changed
+		__sfprelease(fp);	/* set it free */
+		// END android-changed
 		FUNLOCKFILE(fp);
 		errno = sverrno;	/* restore in case _close clobbered */
 		return (NULL);
@@ -142,7 +149,9 @@ freopen(const char *file, const char *mode, FILE *fp)
 
 	/* _file is only a short */
 	if (f > SHRT_MAX) {
-		fp->_flags = 0;		/* set it free */
+		// BEGIN android-changed
+		__sfprelease(fp);	/* set it free */
+		// END android-changed
 		FUNLOCKFILE(fp);
 		errno = EMFILE;
 		return (NULL);
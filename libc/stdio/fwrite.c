@@ -45,7 +45,7 @@
  * Return the number of whole objects written.
  */
 size_t
-fwrite(const void *buf, size_t size, size_t count, FILE *fp)
+fwrite_unlocked(const void *buf, size_t size, size_t count, FILE *fp)
 {
 	size_t n;
 	struct __suio uio;
@@ -78,11 +78,22 @@ fwrite(const void *buf, size_t size, size_t count, FILE *fp)
 	 * skip the divide if this happens, since divides are
 	 * generally slow and since this occurs whenever size==0.
 	 */
-	FLOCKFILE(fp);
 	_SET_ORIENTATION(fp, -1);
 	ret = __sfvwrite(fp, &uio);
-	FUNLOCKFILE(fp);
 	if (ret == 0)
 		return (count);
 	return ((n - uio.uio_resid) / size);
 }
+
+// BEGIN android-added
+size_t
+fwrite(const void *buf, size_t size, size_t count, FILE *fp)
+{
+	size_t ret;
+
+	FLOCKFILE(fp);
+	ret = fwrite_unlocked(buf, size, count, fp);
+	FUNLOCKFILE(fp);
+	return (ret);
+}
+// END android-added
@@ -73,6 +73,10 @@ __LIBC64_HIDDEN__ int _fwalk(int (*)(FILE *));
 #pragma GCC visibility push(hidden)
 
 int	__sflush_locked(FILE *);
+void	__sfprelease(FILE *);
+void	__sfpreclaim(FILE *);
+void	__sfpoutput(FILE *);
+int	_fwalk_output(int (*)(FILE *));
 void	_cleanup(void);
 int	__swhatbuf(FILE *, size_t *, int *);
 wint_t __fgetwc_unlock(FILE *);
@@ -111,8 +115,20 @@ extern void __atexit_register_cleanup(void (*)(void));
 	(fp)->_lb._base = NULL; \
 }
 
-#define FLOCKFILE(fp)   flockfile(fp)
-#define FUNLOCKFILE(fp) funlockfile(fp)
+/*
+ * Regular files are buffered in up to __SREGBUFSIZ bytes rather than a
+ * single st_blksize block, and after __SSEQREADS reads with no intervening
+ * seek the kernel is told to expect sequential access.
+ */
+#define __SREGBUFSIZ (64 * 1024)
+#define __SSEQREADS 2
+
+/*
+ * stdio's own locking is skipped for FILEs whose owner has taken over
+ * responsibility with __fsetlocking(FSETLOCKING_BYCALLER).
+ */
+#define FLOCKFILE(fp)   do { if (!_EXT(fp)->_caller_handles_locking) flockfile(fp); } while (0)
+#define FUNLOCKFILE(fp) do { if (!_EXT(fp)->_caller_handles_locking) funlockfile(fp); } while (0)
 
 #define FLOATING_POINT
 #define PRINTF_WIDE_CHAR
@@ -82,6 +82,13 @@ __swhatbuf(FILE *fp, size_t *bufsize, int *couldbetty)
 {
 	struct stat st;
 
+	// BEGIN android-added
+	// Whatever buffer this FILE gets may come to hold output, so make
+	// sure fflush(NULL) and exit() will find it.
+	if (fp->_flags & (__SWR|__SRW))
+		__sfpoutput(fp);
+	// END android-added
+
 	if (fp->_file < 0 || fstat(fp->_file, &st) < 0) {
 		*couldbetty = 0;
 		*bufsize = BUFSIZ;
@@ -102,6 +109,22 @@ __swhatbuf(FILE *fp, size_t *bufsize, int *couldbetty)
 	 */
 	*bufsize = st.st_blksize;
 	fp->_blksize = st.st_blksize;
+
+	// BEGIN android-added
+	// st_blksize is typically 4KiB, which means a syscall per 4KiB when
+	// streaming through a large regular file. Size the buffer to the file
+	// instead, in whole blocks, up to __SREGBUFSIZ. Files that report a
+	// size of 0 (such as those in /proc) keep a single block.
+	if (S_ISREG(st.st_mode) && st.st_size > st.st_blksize) {
+		size_t size = __SREGBUFSIZ;
+		if (st.st_size < __SREGBUFSIZ) {
+			size = ((st.st_size + st.st_blksize - 1) / st.st_blksize) * st.st_blksize;
+		}
+		if (size > *bufsize) {
+			*bufsize = size;
+		}
+	}
+	// END android-added
 	return ((st.st_mode & S_IFMT) == S_IFREG && fp->_seek == __sseek ?
 	    __SOPT : __SNPT);
 }
@@ -105,7 +105,9 @@ __srefill(FILE *fp)
 	if (fp->_flags & (__SLBF|__SNBF)) {
 		/* Ignore this file in _fwalk to avoid potential deadlock. */
 		fp->_flags |= __SIGN;
-		(void) _fwalk(lflush);
+		// BEGIN android-changed
+		(void) _fwalk_output(lflush);
+		// END android-changed
 		fp->_flags &= ~__SIGN;
 
 		/* Now flush this file without locking it. */
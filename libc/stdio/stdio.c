@@ -52,6 +52,16 @@ __sread(void *cookie, char *buf, int n)
 		fp->_offset += ret;
 	else
 		fp->_flags &= ~__SOFF;	/* paranoia */
+
+	// BEGIN android-added
+	// Once a regular file has been read through a few buffers' worth
+	// without seeking, ask the kernel for more aggressive readahead.
+	if (ret > 0 && (fp->_flags & __SOPT) != 0 && !_EXT(fp)->_seqadvised &&
+	    ++_EXT(fp)->_seqreads >= __SSEQREADS) {
+		_EXT(fp)->_seqadvised = 1;
+		posix_fadvise(fp->_file, 0, 0, POSIX_FADV_SEQUENTIAL);
+	}
+	// END android-added
 	return (ret);
 }
 
@@ -73,6 +83,16 @@ __sseek(void *cookie, fpos_t offset, int whence)
 	off_t ret;
 	
 	ret = lseek(fp->_file, (off_t)offset, whence);
+	// BEGIN android-added
+	// Anything other than a position query breaks the sequential run.
+	if (offset != 0 || whence != SEEK_CUR) {
+		_EXT(fp)->_seqreads = 0;
+		if (_EXT(fp)->_seqadvised) {
+			_EXT(fp)->_seqadvised = 0;
+			posix_fadvise(fp->_file, 0, 0, POSIX_FADV_NORMAL);
+		}
+	}
+	// END android-added
 	if (ret == (off_t)-1)
 		fp->_flags &= ~__SOFF;
 	else {
@@ -110,6 +110,23 @@ __sprint(FILE *fp, struct __suio *uio)
 	return (err);
 }
 
+// BEGIN android-added
+/*
+ * Copy straight into the buffer of a fixed-size string FILE, as set up
+ * by snprintf and friends, truncating silently like __sfvwrite does.
+ * This avoids building I/O vectors for the common string case.
+ */
+static inline void
+__sstrprint(FILE *fp, const char *p, int len)
+{
+	if (len > fp->_w)
+		len = fp->_w;
+	memcpy(fp->_p, p, len);
+	fp->_p += len;
+	fp->_w -= len;
+}
+// END android-added
+
 /*
  * Helper function for `fprintf to unbuffered unix file': creates a
  * temporary buffer.  We only work on write-only files; this avoids
@@ -258,6 +275,172 @@ static int exponent(char *, int, int);
 #define CHARINT		0x0800		/* 8 bit integer */
 #define MAXINT		0x1000		/* largest integer size (intmax_t) */
 
+// BEGIN android-added
+static const char digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/*
+ * Convert val to decimal, writing backwards from cp, and return a
+ * pointer to the first digit.  Two digits are produced per division,
+ * and the loop drops to u_long as soon as the value fits so 32-bit
+ * targets avoid 64-bit division for the common case.
+ */
+static char *
+__ujtoa_dec(uintmax_t val, char *cp)
+{
+	u_long ul;
+
+#if UINTMAX_MAX > ULONG_MAX
+	while (val > ULONG_MAX) {
+		cp -= 2;
+		memcpy(cp, &digit_pairs[(val % 100) * 2], 2);
+		val /= 100;
+	}
+#endif
+	ul = val;
+	while (ul >= 100) {
+		cp -= 2;
+		memcpy(cp, &digit_pairs[(ul % 100) * 2], 2);
+		ul /= 100;
+	}
+	if (ul >= 10) {
+		cp -= 2;
+		memcpy(cp, &digit_pairs[ul * 2], 2);
+	} else
+		*--cp = to_char(ul);
+	return (cp);
+}
+
+#ifdef FLOATING_POINT
+/*
+ * Large enough for the 20 integer digits of a uint64_t plus the at most
+ * 60 fraction digits __fast_dtoa ever produces.
+ */
+#define	FAST_DTOA_BUF	84
+
+/*
+ * Exact fixed-point replacement for __dtoa modes 2 and 3, for doubles
+ * whose integer part fits in 64 bits and whose fraction has at most 60
+ * significant bits.  Each fraction digit then costs one 64-bit multiply
+ * by 10 and the result is correctly rounded (half to even, as gdtoa
+ * does), so the output is identical.  Returns NULL for anything else
+ * (infinities, NaNs, subnormals, very large or very small values) and
+ * the caller falls back to __dtoa.
+ */
+static char *
+__fast_dtoa(double d, int mode, int ndigits, int *decpt, int *sign,
+    char **rve, char *buf)
+{
+	union {
+		double d;
+		uint64_t u;
+	} u;
+	uint64_t mant, ip, frac, mask, half;
+	int e, k, fpos, roundup;
+	char ibuf[20], *p, *q;
+
+	u.d = d;
+	*sign = (int)(u.u >> 63);
+	e = (int)((u.u >> 52) & 0x7ff);
+	mant = u.u & ((1ULL << 52) - 1);
+	if (e == 0x7ff || (e == 0 && mant != 0))
+		return (NULL);
+	if (e == 0) {
+		buf[0] = '0';
+		buf[1] = '\0';
+		*decpt = 1;
+		*rve = buf + 1;
+		return (buf);
+	}
+
+	/* d == mant * 2^e with mant odd. */
+	mant |= 1ULL << 52;
+	e -= 1075;
+	k = __builtin_ctzll(mant);
+	mant >>= k;
+	e += k;
+	if (e >= 0) {
+		if (e > __builtin_clzll(mant))
+			return (NULL);
+		ip = mant << e;
+		frac = 0;
+		k = 0;
+	} else {
+		k = -e;
+		if (k > 60)
+			return (NULL);
+		ip = mant >> k;
+		frac = mant & ((1ULL << k) - 1);
+	}
+
+	p = buf;
+	*decpt = 0;
+	if (ip != 0) {
+		q = __ujtoa_dec(ip, ibuf + sizeof(ibuf));
+		*decpt = ibuf + sizeof(ibuf) - q;
+		memcpy(p, q, *decpt);
+		p += *decpt;
+	}
+
+	roundup = 0;
+	if (mode == 2 && *decpt > ndigits) {
+		/* Rounding position is inside the integer part. */
+		p = buf + ndigits;
+		if (*p > '5')
+			roundup = 1;
+		else if (*p == '5') {
+			for (q = p + 1; q < buf + *decpt && *q == '0'; q++)
+				continue;
+			roundup = q < buf + *decpt || frac != 0 ||
+			    (p[-1] - '0') & 1;
+		}
+	} else {
+		mask = (k != 0) ? (1ULL << k) - 1 : 0;
+		fpos = 0;
+		while (frac != 0 &&
+		    (mode == 3 ? fpos : (int)(p - buf)) < ndigits) {
+			frac *= 10;
+			fpos++;
+			if (p == buf && (frac >> k) == 0)
+				(*decpt)--;	/* leading zero */
+			else
+				*p++ = to_char((int)(frac >> k));
+			frac &= mask;
+		}
+		if (frac != 0) {
+			half = 1ULL << (k - 1);
+			roundup = frac > half || (frac == half &&
+			    p > buf && (p[-1] - '0') & 1);
+		}
+	}
+
+	if (roundup) {
+		while (p > buf && p[-1] == '9')
+			p--;
+		if (p == buf) {
+			*p++ = '1';
+			(*decpt)++;
+		} else
+			p[-1]++;
+	}
+	while (p > buf && p[-1] == '0')
+		p--;
+	*p = '\0';
+	*rve = p;
+	return (buf);
+}
+#endif /* FLOATING_POINT */
+// END android-added
+
 int
 vfprintf(FILE *fp, const char *fmt0, __va_list ap)
 {
@@ -279,6 +462,7 @@ __vfprintf(FILE *fp, const char *fmt0, __va_list ap)
 	struct __siov *iovp;	/* for PRINT macro */
 	int flags;		/* flags as above */
 	int ret;		/* return value accumulator */
+	int strbuf;		/* writing to a fixed-size string buffer */
 	int width;		/* width from format (%8d), or 0 */
 	int prec;		/* precision from format; <0 for N/A */
 	char sign;		/* sign prefix (' ', '+', '-', or \0) */
@@ -313,6 +497,7 @@ __vfprintf(FILE *fp, const char *fmt0, __va_list ap)
 	int ndig;		/* actual number of digits returned by dtoa */
 	char expstr[MAXEXPDIG+2];	/* buffer for exponent string: e+ZZZ */
 	char *dtoaresult = NULL;
+	char fastdtoabuf[FAST_DTOA_BUF];	/* digits from __fast_dtoa */
 #endif
 
 	uintmax_t _umax;	/* integer arguments %[diouxX] */
@@ -353,6 +538,10 @@ __vfprintf(FILE *fp, const char *fmt0, __va_list ap)
 	 * BEWARE, these `goto error' on error, and PAD uses `n'.
 	 */
 #define	PRINT(ptr, len) do { \
+	if (strbuf) { \
+		__sstrprint(fp, (ptr), (len)); \
+		break; \
+	} \
 	iovp->iov_base = (ptr); \
 	iovp->iov_len = (len); \
 	uio.uio_resid += (len); \
@@ -468,6 +657,10 @@ __vfprintf(FILE *fp, const char *fmt0, __va_list ap)
 	    fp->_file >= 0)
 		return (__sbprintf(fp, fmt0, ap));
 
+	// BEGIN android-added
+	strbuf = (fp->_flags & (__SSTR|__SALC)) == __SSTR;
+	// END android-added
+
 	fmt = (char *)fmt0;
 	argtable = NULL;
 	nextarg = 1;
@@ -486,6 +679,11 @@ __vfprintf(FILE *fp, const char *fmt0, __va_list ap)
 	 */
 	for (;;) {
 		cp = fmt;
+		// BEGIN android-added
+		/* '%' never occurs inside a multibyte sequence, so skip ASCII. */
+		while (*fmt != '\0' && *fmt != '%' && (*fmt & 0x80) == 0)
+			fmt++;
+		// END android-added
 		while ((n = mbrtowc(&wc, fmt, MB_CUR_MAX, &ps)) > 0) {
 			fmt += n;
 			if (wc == '%') {
@@ -728,6 +926,9 @@ fp_begin:
 				prec = DEFPREC;
 			if (dtoaresult)
 				__freedtoa(dtoaresult);
+			// BEGIN android-added
+			dtoaresult = NULL;
+			// END android-added
 			if (flags & LONGDBL) {
 				fparg.ldbl = GETARG(long double);
 				dtoaresult = cp =
@@ -739,6 +940,12 @@ fp_begin:
 				}
 			} else {
 				fparg.dbl = GETARG(double);
+				// BEGIN android-added
+				cp = __fast_dtoa(fparg.dbl, expchar ? 2 : 3,
+				    prec, &expt, &signflag, &dtoaend, fastdtoabuf);
+				if (cp != NULL)
+					goto fp_common;
+				// END android-added
 				dtoaresult = cp =
 				    __dtoa(fparg.dbl, expchar ? 2 : 3, prec,
 				    &expt, &signflag, &dtoaend);
@@ -935,12 +1142,7 @@ number:			if ((dprec = prec) >= 0)
 					break;
 
 				case DEC:
-					/* many numbers are 1 digit */
-					while (_umax >= 10) {
-						*--cp = to_char(_umax % 10);
-						_umax /= 10;
-					}
-					*--cp = to_char(_umax);
+					cp = __ujtoa_dec(_umax, cp);
 					break;
 
 				case HEX:
@@ -1208,6 +1410,11 @@ __find_arguments(const char *fmt0, va_list ap, union arg **argtable,
 	 */
 	for (;;) {
 		cp = fmt;
+		// BEGIN android-added
+		/* '%' never occurs inside a multibyte sequence, so skip ASCII. */
+		while (*fmt != '\0' && *fmt != '%' && (*fmt & 0x80) == 0)
+			fmt++;
+		// END android-added
 		while ((n = mbrtowc(&wc, fmt, MB_CUR_MAX, &ps)) > 0) {
 			fmt += n;
 			if (wc == '%') {
@@ -4954,6 +4954,9 @@ static void* internal_memalign(mstate m, size_t alignment, size_t bytes) {
         if (is_mmapped(p)) { /* For mmapped chunks, just adjust offset */
           newp->prev_foot = p->prev_foot + leadsize;
           newp->head = newsize;
+          /* BEGIN android-added: so dlmalloc_iterate can't find the old chunk */
+          p->head = 0;
+          /* END android-added */
         }
         else { /* Otherwise, give back leader, use the rest */
           set_inuse(m, newp, newsize);
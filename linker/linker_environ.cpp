@@ -126,6 +126,8 @@ static bool __is_unsafe_environment_variable(const char* name) {
       "LD_PROFILE",
       "LD_SHOW_AUXV",
       "LD_USE_LOAD_BIAS",
+      "LIBC_MALLOC_STATS",
+      "LIBC_MALLOC_STATS_SIGNAL",
       "LOCALDOMAIN",
       "LOCPATH",
       "MALLOC_CHECK_",
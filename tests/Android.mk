@@ -93,6 +93,7 @@ libBionicStandardTests_src_files := \
     stack_unwinding_test.cpp \
     stdatomic_test.cpp \
     stdint_test.cpp \
+    stdio_ext_test.cpp \
     stdio_test.cpp \
     stdlib_test.cpp \
     string_test.cpp \
@@ -227,6 +228,7 @@ bionic-unit-tests_src_files := \
     atexit_test.cpp \
     dlext_test.cpp \
     dlfcn_test.cpp \
+    malloc_debug_test.cpp \
 
 bionic-unit-tests_cflags := $(test_cflags)
 
@@ -369,6 +369,27 @@ void RunSingleBufferOverreadTest(void (*test_func)(uint8_t*, size_t)) {
   free(memory);
 }
 
+void RunSingleBufferUnderreadTest(void (*test_func)(uint8_t*, size_t)) {
+  // In order to verify that functions working backwards are not reading
+  // before the start of the buffer, create data that starts exactly at an
+  // unreadable memory boundary.
+  size_t pagesize = static_cast<size_t>(sysconf(_SC_PAGE_SIZE));
+  uint8_t* memory;
+  ASSERT_TRUE(posix_memalign(reinterpret_cast<void**>(&memory), pagesize,
+                             2*pagesize) == 0);
+  memset(memory, 0x23, 2*pagesize);
+
+  // Make the first page unreadable and unwritable.
+  ASSERT_TRUE(mprotect(memory, pagesize, PROT_NONE) == 0);
+
+  uint8_t* buf = &memory[pagesize];
+  for (size_t i = 0; i <= pagesize; i++) {
+    test_func(buf, i);
+  }
+  ASSERT_TRUE(mprotect(memory, pagesize, PROT_READ | PROT_WRITE) == 0);
+  free(memory);
+}
+
 void RunSrcDstBufferOverreadTest(void (*test_func)(uint8_t*, uint8_t*, size_t)) {
   // In order to verify that functions are not reading past the end of the
   // src, create data that ends exactly at an unreadable memory boundary.
@@ -35,6 +35,8 @@ void RunCmpBufferAlignTest(
 
 void RunSingleBufferOverreadTest(void (*test_func)(uint8_t*, size_t));
 
+void RunSingleBufferUnderreadTest(void (*test_func)(uint8_t*, size_t));
+
 void RunSrcDstBufferOverreadTest(void (*test_func)(uint8_t*, uint8_t*, size_t));
 
 void RunCmpBufferOverreadTest(
@@ -0,0 +1,435 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <dlfcn.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <unwind.h>
+
+#include "bionic/debug_frame_pointer.h"
+#include "bionic/malloc_debug_common.h"
+#include "private/ScopeGuard.h"
+
+static HashTable g_hash_table;
+static const MallocDebug g_dispatch = {
+  ::calloc, ::free, ::mallinfo, ::malloc, ::malloc_usable_size, ::memalign, ::posix_memalign,
+#if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
+  ::pvalloc,
+#endif
+  ::realloc,
+#if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
+  ::valloc,
+#endif
+};
+
+// Loads the debug malloc library and sets it up the way libc does when
+// libc.debug.malloc is set, but recording into g_hash_table, so that the debug
+// allocators can be called directly without having to restart the process
+// with the property set.
+static void* GetDebugMallocHandle() {
+  static void* debug_handle = []() -> void* {
+    void* handle = dlopen("libc_malloc_debug_leak.so", RTLD_NOW);
+    if (handle == NULL) {
+      return NULL;
+    }
+    MallocDebugInit init =
+        reinterpret_cast<MallocDebugInit>(dlsym(handle, "malloc_debug_initialize"));
+    if (init == NULL || !init(&g_hash_table, &g_dispatch)) {
+      return NULL;
+    }
+    return handle;
+  }();
+  return debug_handle;
+}
+
+template<typename FunctionType>
+static FunctionType GetDebugMallocFunction(const char* symbol) {
+  void* handle = GetDebugMallocHandle();
+  return (handle == NULL) ? NULL : reinterpret_cast<FunctionType>(dlsym(handle, symbol));
+}
+
+// The libc.debug.malloc=15 guard page allocator.
+class GuardMalloc {
+ public:
+  GuardMalloc()
+      : malloc_(GetDebugMallocFunction<MallocDebugMalloc>("guard_malloc")),
+        free_(GetDebugMallocFunction<MallocDebugFree>("guard_free")) {
+  }
+
+  bool ok() { return malloc_ != NULL && free_ != NULL; }
+  char* malloc(size_t bytes) { return reinterpret_cast<char*>(malloc_(bytes)); }
+  void free(void* mem) { free_(mem); }
+
+ private:
+  MallocDebugMalloc malloc_;
+  MallocDebugFree free_;
+};
+
+static GuardMalloc& GetGuardMalloc() {
+  static GuardMalloc guard;
+  return guard;
+}
+
+// The default sample rate of 1 guards every allocation that fits, and sizes
+// that are a multiple of MALLOC_ALIGNMENT end right at the guard page.
+static const size_t kGuardedSize = 8 * MALLOC_ALIGNMENT;
+
+TEST(malloc_debug_guard, in_bounds) {
+  GuardMalloc& guard = GetGuardMalloc();
+  ASSERT_TRUE(guard.ok());
+  char* p = guard.malloc(kGuardedSize);
+  ASSERT_TRUE(p != NULL);
+  for (size_t i = 0; i < kGuardedSize; ++i) {
+    ASSERT_EQ(0, p[i]);
+    p[i] = 1;
+  }
+  guard.free(p);
+}
+
+static void WritePastEnd() {
+  GuardMalloc& guard = GetGuardMalloc();
+  volatile char* p = guard.malloc(kGuardedSize);
+  p[kGuardedSize] = 1;
+}
+
+TEST(malloc_debug_guard_DeathTest, overrun) {
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  ASSERT_TRUE(GetGuardMalloc().ok());
+  ASSERT_EXIT(WritePastEnd(), testing::KilledBySignal(SIGSEGV), "");
+}
+
+static void UseAfterFree() {
+  GuardMalloc& guard = GetGuardMalloc();
+  volatile char* p = guard.malloc(kGuardedSize);
+  guard.free(const_cast<char*>(p));
+  p[0] = 1;
+}
+
+TEST(malloc_debug_guard_DeathTest, use_after_free) {
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  ASSERT_TRUE(GetGuardMalloc().ok());
+  ASSERT_EXIT(UseAfterFree(), testing::KilledBySignal(SIGSEGV), "");
+}
+
+// The libc.debug.malloc=2 sampling allocator.
+class SampleMalloc {
+ public:
+  SampleMalloc()
+      : malloc_(GetDebugMallocFunction<MallocDebugMalloc>("sample_malloc")),
+        free_(GetDebugMallocFunction<MallocDebugFree>("sample_free")),
+        realloc_(GetDebugMallocFunction<MallocDebugRealloc>("sample_realloc")) {
+  }
+
+  bool ok() { return malloc_ != NULL && free_ != NULL && realloc_ != NULL; }
+  void* malloc(size_t bytes) { return malloc_(bytes); }
+  void free(void* mem) { free_(mem); }
+  void* realloc(void* mem, size_t bytes) { return realloc_(mem, bytes); }
+
+ private:
+  MallocDebugMalloc malloc_;
+  MallocDebugFree free_;
+  MallocDebugRealloc realloc_;
+};
+
+static SampleMalloc& GetSampleMalloc() {
+  static SampleMalloc sample;
+  return sample;
+}
+
+// Gaps between samples are capped at about 18 times the sample rate, so with
+// the default rate of 512KiB every allocation this big is sampled.
+static const size_t kSampledSize = 64 * 1024 * 1024;
+
+// Returns how many live allocations of the given size get_malloc_leak_info
+// would report.
+static size_t SampledAllocations(size_t size) {
+  size_t allocations = 0;
+  for (size_t i = 0; i < HASHTABLE_SIZE; ++i) {
+    for (HashEntry* entry = g_hash_table.slots[i]; entry != NULL; entry = entry->next) {
+      if (entry->size == size) {
+        allocations += entry->allocations;
+      }
+    }
+  }
+  return allocations;
+}
+
+TEST(malloc_debug_sample, live_allocations) {
+  SampleMalloc& sample = GetSampleMalloc();
+  ASSERT_TRUE(sample.ok());
+  void* p = sample.malloc(kSampledSize);
+  ASSERT_TRUE(p != NULL);
+  ASSERT_EQ(1U, SampledAllocations(kSampledSize));
+  void* q = sample.malloc(kSampledSize);
+  ASSERT_TRUE(q != NULL);
+  ASSERT_EQ(2U, SampledAllocations(kSampledSize));
+  sample.free(p);
+  ASSERT_EQ(1U, SampledAllocations(kSampledSize));
+  sample.free(q);
+  ASSERT_EQ(0U, SampledAllocations(kSampledSize));
+}
+
+TEST(malloc_debug_sample, realloc) {
+  SampleMalloc& sample = GetSampleMalloc();
+  ASSERT_TRUE(sample.ok());
+  void* p = sample.malloc(kSampledSize);
+  ASSERT_TRUE(p != NULL);
+  ASSERT_EQ(1U, SampledAllocations(kSampledSize));
+
+  // A failed realloc leaves the old allocation, and its sample, in place.
+  ASSERT_TRUE(sample.realloc(p, SIZE_MAX / 2) == NULL);
+  ASSERT_EQ(1U, SampledAllocations(kSampledSize));
+
+  p = sample.realloc(p, 2 * kSampledSize);
+  ASSERT_TRUE(p != NULL);
+  ASSERT_EQ(0U, SampledAllocations(kSampledSize));
+  ASSERT_EQ(1U, SampledAllocations(2 * kSampledSize));
+  sample.free(p);
+  ASSERT_EQ(0U, SampledAllocations(2 * kSampledSize));
+}
+
+#if defined(HAVE_FRAME_POINTER_BACKTRACE)
+static bool GetStackBounds(uintptr_t* lo, uintptr_t* hi) {
+  pthread_attr_t attr;
+  if (pthread_getattr_np(pthread_self(), &attr) != 0) {
+    return false;
+  }
+  void* stack_base;
+  size_t stack_size;
+  int result = pthread_attr_getstack(&attr, &stack_base, &stack_size);
+  pthread_attr_destroy(&attr);
+  *lo = reinterpret_cast<uintptr_t>(stack_base);
+  *hi = *lo + stack_size;
+  return result == 0;
+}
+
+static const size_t kBacktraceDepth = 3;
+
+// Each level records the return address into its caller. Taking the frame
+// address makes sure each level has a frame record, and the empty asm after
+// each call stops it being turned into a tail call.
+__attribute__((noinline)) static size_t BacktraceLevel3(uintptr_t* expected, uintptr_t* frames) {
+  expected[0] = reinterpret_cast<uintptr_t>(__builtin_return_address(0));
+  uintptr_t lo, hi;
+  if (!GetStackBounds(&lo, &hi)) {
+    return 0;
+  }
+  return frame_pointer_backtrace(reinterpret_cast<uintptr_t>(__builtin_frame_address(0)),
+                                 lo, hi, frames, kBacktraceDepth);
+}
+
+__attribute__((noinline)) static size_t BacktraceLevel2(uintptr_t* expected, uintptr_t* frames) {
+  expected[1] = reinterpret_cast<uintptr_t>(__builtin_return_address(0));
+  *reinterpret_cast<void* volatile*>(frames) = __builtin_frame_address(0);
+  size_t frame_count = BacktraceLevel3(expected, frames);
+  __asm__ __volatile__("" ::: "memory");
+  return frame_count;
+}
+
+__attribute__((noinline)) static size_t BacktraceLevel1(uintptr_t* expected, uintptr_t* frames) {
+  expected[2] = reinterpret_cast<uintptr_t>(__builtin_return_address(0));
+  *reinterpret_cast<void* volatile*>(frames) = __builtin_frame_address(0);
+  size_t frame_count = BacktraceLevel2(expected, frames);
+  __asm__ __volatile__("" ::: "memory");
+  return frame_count;
+}
+
+static size_t g_fallback_calls;
+
+struct UnwindState {
+  uintptr_t* frames;
+  size_t frame_count;
+  size_t max_depth;
+};
+
+static _Unwind_Reason_Code CollectFrame(_Unwind_Context* context, void* arg) {
+  UnwindState* state = static_cast<UnwindState*>(arg);
+  state->frames[state->frame_count++] = _Unwind_GetIP(context);
+  return (state->frame_count >= state->max_depth) ? _URC_END_OF_STACK : _URC_NO_REASON;
+}
+
+static size_t UnwindFallback(uintptr_t* frames, size_t max_depth) {
+  ++g_fallback_calls;
+  UnwindState state = { frames, 0, max_depth };
+  _Unwind_Backtrace(CollectFrame, &state);
+  return state.frame_count;
+}
+#endif
+
+TEST(malloc_debug_frame_pointer, caller_pcs) {
+#if defined(HAVE_FRAME_POINTER_BACKTRACE)
+  uintptr_t expected[kBacktraceDepth];
+  uintptr_t frames[kBacktraceDepth];
+  ASSERT_EQ(kBacktraceDepth, BacktraceLevel1(expected, frames));
+  for (size_t i = 0; i < kBacktraceDepth; ++i) {
+    ASSERT_EQ(expected[i], frames[i]) << "frame " << i;
+  }
+#else
+  GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
+}
+
+TEST(malloc_debug_frame_pointer, corrupt_chain) {
+#if defined(HAVE_FRAME_POINTER_BACKTRACE)
+  // A fake stack of frame records, each the next frame pointer and a return address.
+  uintptr_t stack[16] = {};
+  uintptr_t lo = reinterpret_cast<uintptr_t>(&stack[0]);
+  uintptr_t hi = reinterpret_cast<uintptr_t>(&stack[16]);
+  uintptr_t frames[8];
+
+  // A chain that turns back on itself stops there.
+  stack[0] = reinterpret_cast<uintptr_t>(&stack[4]);
+  stack[1] = 0x1000;
+  stack[4] = reinterpret_cast<uintptr_t>(&stack[2]);
+  stack[5] = 0x2000;
+  ASSERT_EQ(2U, frame_pointer_backtrace(lo, lo, hi, frames, 8));
+  ASSERT_EQ(0x1000U, frames[0]);
+  ASSERT_EQ(0x2000U, frames[1]);
+
+  // So does one that leaves the stack, or isn't aligned.
+  stack[4] = hi + 64;
+  ASSERT_EQ(2U, frame_pointer_backtrace(lo, lo, hi, frames, 8));
+  stack[4] = reinterpret_cast<uintptr_t>(&stack[8]) + 1;
+  ASSERT_EQ(2U, frame_pointer_backtrace(lo, lo, hi, frames, 8));
+  stack[4] = reinterpret_cast<uintptr_t>(&stack[15]);
+  ASSERT_EQ(2U, frame_pointer_backtrace(lo, lo, hi, frames, 8));
+
+  // With no usable first record, we unwind instead.
+  g_fallback_calls = 0;
+  ASSERT_NE(0U, frame_pointer_backtrace_or(UnwindFallback, hi, lo, hi, frames, 8));
+  ASSERT_EQ(1U, g_fallback_calls);
+  stack[1] = 0;
+  ASSERT_NE(0U, frame_pointer_backtrace_or(UnwindFallback, lo, lo, hi, frames, 8));
+  ASSERT_EQ(2U, g_fallback_calls);
+#else
+  GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
+}
+
+#if defined(HAVE_FRAME_POINTER_BACKTRACE)
+static uintptr_t g_stack_lo;
+static uintptr_t g_stack_hi;
+static size_t g_altstack_frame_count;
+
+static void AltStackBacktrace(int) {
+  uintptr_t frames[16];
+  g_altstack_frame_count =
+      frame_pointer_backtrace_or(UnwindFallback, reinterpret_cast<uintptr_t>(__builtin_frame_address(0)),
+                                 g_stack_lo, g_stack_hi, frames, 16);
+}
+#endif
+
+TEST(malloc_debug_frame_pointer, alternate_signal_stack) {
+#if defined(HAVE_FRAME_POINTER_BACKTRACE)
+  ASSERT_TRUE(GetStackBounds(&g_stack_lo, &g_stack_hi));
+
+  // The handler's frame records are outside the thread's stack, so we unwind instead.
+  void* altstack = malloc(64 * 1024);
+  ASSERT_TRUE(altstack != NULL);
+  stack_t ss;
+  ss.ss_sp = altstack;
+  ss.ss_size = 64 * 1024;
+  ss.ss_flags = 0;
+  stack_t old_ss;
+  ASSERT_EQ(0, sigaltstack(&ss, &old_ss));
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = AltStackBacktrace;
+  sa.sa_flags = SA_ONSTACK;
+  struct sigaction old_sa;
+  ASSERT_EQ(0, sigaction(SIGUSR1, &sa, &old_sa));
+
+  g_fallback_calls = 0;
+  g_altstack_frame_count = 0;
+  raise(SIGUSR1);
+
+  ASSERT_EQ(0, sigaction(SIGUSR1, &old_sa, NULL));
+  ss.ss_flags = SS_DISABLE;
+  ASSERT_EQ(0, sigaltstack((old_ss.ss_flags & SS_DISABLE) ? &ss : &old_ss, NULL));
+  free(altstack);
+
+  ASSERT_EQ(1U, g_fallback_calls);
+  ASSERT_NE(0U, g_altstack_frame_count);
+#else
+  GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
+}
+
+// Allocation statistics are only collected if they're enabled when the
+// process starts, so these checks run in a new process started with them
+// enabled in its environment. Each failure exits with a different code.
+static void CheckStatistics() {
+  malloc_statistics before;
+  if (malloc_get_thread_statistics(&before) != 0) {
+    _exit(1);
+  }
+
+  void* ptr = malloc(1000);
+  size_t size = malloc_usable_size(ptr);
+  malloc_statistics after;
+  malloc_get_thread_statistics(&after);
+  if (after.allocations != before.allocations + 1 ||
+      after.allocated_bytes != before.allocated_bytes + size) {
+    _exit(2);
+  }
+  free(ptr);
+  malloc_get_thread_statistics(&after);
+  if (after.frees != before.frees + 1 || after.freed_bytes != before.freed_bytes + size) {
+    _exit(3);
+  }
+
+  // The size classes add up to the totals, and cover every size.
+  size_t allocations = 0;
+  for (size_t i = 0; i < MALLOC_STATISTICS_SIZE_CLASSES; ++i) {
+    allocations += after.classes[i].allocations;
+  }
+  if (allocations != after.allocations ||
+      after.classes[MALLOC_STATISTICS_SIZE_CLASSES - 1].max_size != SIZE_MAX) {
+    _exit(4);
+  }
+
+  malloc_statistics process;
+  if (malloc_get_statistics(&process) != 0 || process.allocations < after.allocations) {
+    _exit(5);
+  }
+
+  // LIBC_MALLOC_STATS_SIGNAL makes this dump the statistics to stderr.
+  raise(SIGUSR2);
+  _exit(0);
+}
+
+TEST(malloc_stats_DeathTest, statistics) {
+  ::testing::FLAGS_gtest_death_test_style = "threadsafe";
+  char signal_number[16];
+  snprintf(signal_number, sizeof(signal_number), "%d", SIGUSR2);
+  auto guard = make_scope_guard([]() {
+    unsetenv("LIBC_MALLOC_STATS");
+    unsetenv("LIBC_MALLOC_STATS_SIGNAL");
+  });
+  ASSERT_EQ(0, setenv("LIBC_MALLOC_STATS", "1", 1));
+  ASSERT_EQ(0, setenv("LIBC_MALLOC_STATS_SIGNAL", signal_number, 1));
+
+  ASSERT_EXIT(CheckStatistics(), testing::ExitedWithCode(0),
+              "malloc statistics: [0-9]+ bytes in [0-9]+ allocations");
+}
@@ -16,12 +16,19 @@
 
 #include <gtest/gtest.h>
 
+#include <errno.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <malloc.h>
+#include <pthread.h>
 #include <unistd.h>
 
+#include <new>
+
 #include "private/bionic_config.h"
 
 TEST(malloc, malloc_std) {
@@ -293,6 +300,259 @@ TEST(malloc, realloc_overflow) {
   free(ptr);
 }
 
+static void* FreeAndAllocate(void* arg) {
+  // Free memory allocated by another thread, and allocate some of our own for
+  // another thread to free.
+  char** ptrs = reinterpret_cast<char**>(arg);
+  for (size_t i = 0; i < 1000; ++i) {
+    for (size_t j = 0; j < i % 200; ++j) {
+      if (ptrs[i][j] != static_cast<char>(i)) {
+        return ptrs[i];
+      }
+    }
+    free(ptrs[i]);
+    ptrs[i] = reinterpret_cast<char*>(calloc(1, i % 200));
+    if (ptrs[i] == NULL) {
+      return arg;
+    }
+  }
+  return NULL;
+}
+
+TEST(malloc, malloc_multiple_threads) {
+  char* ptrs[1000];
+  for (size_t i = 0; i < 1000; ++i) {
+    ptrs[i] = reinterpret_cast<char*>(malloc(i % 200));
+    ASSERT_TRUE(ptrs[i] != NULL);
+    memset(ptrs[i], i, i % 200);
+  }
+
+  pthread_t t;
+  ASSERT_EQ(0, pthread_create(&t, NULL, FreeAndAllocate, ptrs));
+  void* result;
+  ASSERT_EQ(0, pthread_join(t, &result));
+  ASSERT_EQ(NULL, result);
+
+  // The other thread has exited, but its memory is still good.
+  for (size_t i = 0; i < 1000; ++i) {
+    ASSERT_LE(i % 200, malloc_usable_size(ptrs[i]));
+    for (size_t j = 0; j < i % 200; ++j) {
+      ASSERT_EQ(0, ptrs[i][j]);
+    }
+    free(ptrs[i]);
+  }
+}
+
+// Returns the number of bytes of this process's memory that are resident.
+static size_t GetRss() {
+  FILE* fp = fopen("/proc/self/statm", "r");
+  if (fp == NULL) {
+    return 0;
+  }
+  size_t size;
+  size_t resident = 0;
+  if (fscanf(fp, "%zu %zu", &size, &resident) != 2) {
+    resident = 0;
+  }
+  fclose(fp);
+  return resident * getpagesize();
+}
+
+TEST(malloc, malloc_trim) {
+  // Leave gaps between live allocations so there's free memory in the middle of the heap,
+  // about 7MiB of it, all of it dirty.
+  char* ptrs[1000];
+  for (size_t i = 0; i < 1000; ++i) {
+    ptrs[i] = reinterpret_cast<char*>(malloc(8192));
+    ASSERT_TRUE(ptrs[i] != NULL);
+    memset(ptrs[i], 0xa5, 8192);
+  }
+  for (size_t i = 0; i < 1000; ++i) {
+    if (i % 10 != 0) {
+      free(ptrs[i]);
+    }
+  }
+  size_t rss_before = GetRss();
+  ASSERT_NE(0U, rss_before);
+  ASSERT_EQ(1, malloc_trim(0));
+  size_t rss_after = GetRss();
+  // Each gap is 72KiB, so well over half of the freed memory is in whole pages.
+  ASSERT_LT(rss_after + 4 * 1024 * 1024, rss_before);
+
+  // What's still allocated is untouched, and freed memory can be reused.
+  for (size_t i = 0; i < 1000; i += 10) {
+    ASSERT_EQ(0xa5, static_cast<unsigned char>(ptrs[i][0]));
+    ASSERT_EQ(0xa5, static_cast<unsigned char>(ptrs[i][8191]));
+    free(ptrs[i]);
+  }
+  char* ptr = reinterpret_cast<char*>(malloc(8192));
+  ASSERT_TRUE(ptr != NULL);
+  memset(ptr, 0, 8192);
+  free(ptr);
+}
+
+TEST(malloc, mallopt_decay_time) {
+#if defined(__BIONIC__)
+  ASSERT_EQ(0, mallopt(M_DECAY_TIME, -1));
+  ASSERT_EQ(1, mallopt(M_DECAY_TIME, 1));
+  void* ptr = malloc(100000);
+  ASSERT_TRUE(ptr != NULL);
+  free(ptr);
+  ASSERT_EQ(1, mallopt(M_DECAY_TIME, 0));
+#else // __BIONIC__
+  GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif // __BIONIC__
+}
+
+#if defined(__BIONIC__)
+struct iterate_test_state {
+  uintptr_t ptrs[3];
+  size_t sizes[3];
+  size_t found[3];
+};
+
+static void iterate_test_callback(uintptr_t base, size_t size, void* arg) {
+  iterate_test_state* state = reinterpret_cast<iterate_test_state*>(arg);
+  for (size_t i = 0; i < 3; ++i) {
+    if (base == state->ptrs[i] && size >= state->sizes[i]) {
+      ++state->found[i];
+    }
+  }
+}
+#endif // __BIONIC__
+
+TEST(malloc, malloc_iterate) {
+#if defined(__BIONIC__)
+  iterate_test_state state;
+  memset(&state, 0, sizeof(state));
+  state.sizes[0] = 8;
+  state.sizes[1] = 1000;
+  state.sizes[2] = 1024 * 1024;
+  void* ptrs[3];
+  for (size_t i = 0; i < 3; ++i) {
+    ptrs[i] = malloc(state.sizes[i]);
+    ASSERT_TRUE(ptrs[i] != NULL);
+    state.ptrs[i] = reinterpret_cast<uintptr_t>(ptrs[i]);
+  }
+
+  // Find the heap before malloc_disable, since reading the maps allocates.
+  uintptr_t starts[256];
+  uintptr_t ends[256];
+  size_t count = 0;
+  FILE* fp = fopen("/proc/self/maps", "re");
+  ASSERT_TRUE(fp != NULL);
+  char line[BUFSIZ];
+  while (count < 256 && fgets(line, sizeof(line), fp) != NULL) {
+    if (strstr(line, "[anon:libc_malloc]") != NULL &&
+        sscanf(line, "%" SCNxPTR "-%" SCNxPTR, &starts[count], &ends[count]) == 2) {
+      ++count;
+    }
+  }
+  fclose(fp);
+
+  malloc_disable();
+  int result = 0;
+  for (size_t i = 0; i < count && result == 0; ++i) {
+    result = malloc_iterate(starts[i], ends[i] - starts[i], iterate_test_callback, &state);
+  }
+  int saved_errno = errno;
+  malloc_enable();
+
+  if (result == -1) {
+    ASSERT_EQ(ENOTSUP, saved_errno);
+  } else {
+    ASSERT_EQ(0, result);
+    for (size_t i = 0; i < 3; ++i) {
+      ASSERT_EQ(1U, state.found[i]);
+    }
+  }
+  for (size_t i = 0; i < 3; ++i) {
+    free(ptrs[i]);
+  }
+#else // __BIONIC__
+  GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif // __BIONIC__
+}
+
+TEST(malloc, malloc_get_thread_statistics) {
+#if defined(__BIONIC__)
+  malloc_statistics before;
+  if (malloc_get_thread_statistics(&before) == -1) {
+    // Statistics are only collected if libc.malloc.stats is set.
+    ASSERT_EQ(ENOTSUP, errno);
+    return;
+  }
+
+  void* ptr = malloc(1000);
+  ASSERT_TRUE(ptr != NULL);
+  size_t size = malloc_usable_size(ptr);
+  malloc_statistics after;
+  ASSERT_EQ(0, malloc_get_thread_statistics(&after));
+  ASSERT_EQ(before.allocations + 1, after.allocations);
+  ASSERT_EQ(before.allocated_bytes + size, after.allocated_bytes);
+  free(ptr);
+  ASSERT_EQ(0, malloc_get_thread_statistics(&after));
+  ASSERT_EQ(before.frees + 1, after.frees);
+  ASSERT_EQ(before.freed_bytes + size, after.freed_bytes);
+
+  // The size classes add up to the totals, and cover every size.
+  size_t allocations = 0;
+  for (size_t i = 0; i < MALLOC_STATISTICS_SIZE_CLASSES; ++i) {
+    allocations += after.classes[i].allocations;
+  }
+  ASSERT_EQ(after.allocations, allocations);
+  ASSERT_EQ(SIZE_MAX, after.classes[MALLOC_STATISTICS_SIZE_CLASSES - 1].max_size);
+#else // __BIONIC__
+  GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif // __BIONIC__
+}
+
+TEST(malloc, free_sized) {
+#if defined(__BIONIC__)
+  free_sized(NULL, 0);
+  for (size_t size = 1; size <= 1024 * 1024; size *= 4) {
+    void* ptr = malloc(size);
+    ASSERT_TRUE(ptr != NULL);
+    free_sized(ptr, size);
+    ptr = memalign(64, size);
+    ASSERT_TRUE(ptr != NULL);
+    free_aligned_sized(ptr, 64, size);
+  }
+#else // __BIONIC__
+  GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif // __BIONIC__
+}
+
+// Only code built for C++17 and C++14 gets these declarations from <new>.
+#if defined(__cpp_aligned_new)
+TEST(malloc, operator_new_aligned) {
+#if defined(__BIONIC__)
+  for (size_t alignment = 1; alignment <= 8192; alignment *= 2) {
+    void* ptr = operator new(100, static_cast<std::align_val_t>(alignment));
+    ASSERT_EQ(0U, reinterpret_cast<uintptr_t>(ptr) % alignment);
+    ASSERT_LE(100U, malloc_usable_size(ptr));
+    operator delete(ptr, 100, static_cast<std::align_val_t>(alignment));
+
+    ptr = operator new[](100, static_cast<std::align_val_t>(alignment), std::nothrow);
+    ASSERT_TRUE(ptr != NULL);
+    ASSERT_EQ(0U, reinterpret_cast<uintptr_t>(ptr) % alignment);
+    operator delete[](ptr, static_cast<std::align_val_t>(alignment));
+  }
+#else // __BIONIC__
+  GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif // __BIONIC__
+}
+#endif
+
+#if defined(__cpp_sized_deallocation)
+TEST(malloc, operator_delete_sized) {
+  void* ptr = operator new(100);
+  operator delete(ptr, 100);
+  ptr = operator new[](100);
+  operator delete[](ptr, 100);
+}
+#endif
+
 #if defined(HAVE_DEPRECATED_MALLOC_FUNCS)
 extern "C" void* pvalloc(size_t);
 extern "C" void* valloc(size_t);
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <stdio_ext.h>
+#include <string.h>
+
+#include "TemporaryFile.h"
+
+TEST(stdio_ext, __fsetlocking) {
+  FILE* fp = fopen("/proc/version", "r");
+  ASSERT_TRUE(fp != NULL);
+  ASSERT_EQ(FSETLOCKING_INTERNAL, __fsetlocking(fp, FSETLOCKING_QUERY));
+  ASSERT_EQ(FSETLOCKING_INTERNAL, __fsetlocking(fp, FSETLOCKING_BYCALLER));
+  ASSERT_EQ(FSETLOCKING_BYCALLER, __fsetlocking(fp, FSETLOCKING_QUERY));
+  ASSERT_EQ(FSETLOCKING_BYCALLER, __fsetlocking(fp, FSETLOCKING_INTERNAL));
+  ASSERT_EQ(FSETLOCKING_INTERNAL, __fsetlocking(fp, FSETLOCKING_QUERY));
+  fclose(fp);
+}
+
+TEST(stdio_ext, __fsetlocking_BYCALLER_io) {
+  // With the caller handling locking, the locked functions must still work.
+  TemporaryFile tf;
+  FILE* fp = fdopen(tf.fd, "w+");
+  ASSERT_TRUE(fp != NULL);
+  __fsetlocking(fp, FSETLOCKING_BYCALLER);
+
+  ASSERT_LE(0, fputs("hello\n", fp));
+  ASSERT_EQ(5, fprintf(fp, "%d\n", 1234));
+  ASSERT_EQ(0, fflush(fp));
+  rewind(fp);
+
+  char buf[16];
+  ASSERT_EQ(buf, fgets(buf, sizeof(buf), fp));
+  ASSERT_STREQ("hello\n", buf);
+  int i;
+  ASSERT_EQ(1, fscanf(fp, "%d", &i));
+  ASSERT_EQ(1234, i);
+
+  // flockfile still works as an explicit lock.
+  flockfile(fp);
+  funlockfile(fp);
+  fclose(fp);
+}
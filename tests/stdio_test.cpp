@@ -27,6 +27,8 @@
 #include <wchar.h>
 #include <locale.h>
 
+#include <string>
+
 #include "TemporaryFile.h"
 
 TEST(stdio, flockfile_18208568_stderr) {
@@ -426,6 +428,51 @@ TEST(stdio, snprintf_lld_LLONG_MIN) {
   EXPECT_STREQ("-9223372036854775808", buf);
 }
 
+TEST(stdio, snprintf_d_digit_counts) {
+  char buf[BUFSIZ];
+  char expected[BUFSIZ];
+  unsigned long long value = 0;
+  for (int digits = 1; digits <= 20; ++digits) {
+    value = value * 10 + (digits % 10);
+    snprintf(buf, sizeof(buf), "%llu", value);
+    expected[digits - 1] = '0' + (digits % 10);
+    expected[digits] = '\0';
+    EXPECT_STREQ(expected, buf);
+  }
+
+  snprintf(buf, sizeof(buf), "%d %d %d %d", 0, 9, 10, 99);
+  EXPECT_STREQ("0 9 10 99", buf);
+  snprintf(buf, sizeof(buf), "%u %llu", UINT_MAX, ULLONG_MAX);
+  EXPECT_STREQ("4294967295 18446744073709551615", buf);
+}
+
+TEST(stdio, snprintf_f_rounding) {
+  char buf[BUFSIZ];
+
+  // Exact ties round to even.
+  snprintf(buf, sizeof(buf), "%.0f %.0f %.0f %.2f %.2f", 0.5, 1.5, 2.5, 0.125, 0.375);
+  EXPECT_STREQ("0 2 2 0.12 0.38", buf);
+
+  // Values that aren't exact round to nearest.
+  snprintf(buf, sizeof(buf), "%.1f %.2f %.3f", 0.05, 0.015, 1.0005);
+  EXPECT_STREQ("0.1 0.01 1.000", buf);
+
+  // Carries out of the last digit.
+  snprintf(buf, sizeof(buf), "%.1f %.2f %.0f %.3g %.2e", 9.96, 0.999, 999999.5, 99.96, 9.999);
+  EXPECT_STREQ("10.0 1.00 1000000 100 1.00e+01", buf);
+
+  snprintf(buf, sizeof(buf), "%f %g %e", 1234.5678, 1234.5678, 1234.5678);
+  EXPECT_STREQ("1234.567800 1234.57 1.234568e+03", buf);
+  snprintf(buf, sizeof(buf), "%g %g %g %g", 0.1, 100000.0, 1000000.0, 1e-5);
+  EXPECT_STREQ("0.1 100000 1e+06 1e-05", buf);
+  snprintf(buf, sizeof(buf), "%.20f", 0.1);
+  EXPECT_STREQ("0.10000000000000000555", buf);
+  snprintf(buf, sizeof(buf), "%.0f", 9007199254740993.0);
+  EXPECT_STREQ("9007199254740992", buf);
+  snprintf(buf, sizeof(buf), "%.0f", 1e20);
+  EXPECT_STREQ("100000000000000000000", buf);
+}
+
 TEST(stdio, snprintf_e) {
   char buf[BUFSIZ];
 
@@ -725,3 +772,388 @@ TEST(stdio, fread_unbuffered_pathological_performance) {
     ASSERT_EQ('\xff', buf[i]);
   }
 }
+
+TEST(stdio, large_regular_file_sequential_then_seek) {
+  // Regular files get a buffer larger than st_blksize, and sequential reads
+  // switch on readahead; make sure neither breaks seeking back afterwards.
+  TemporaryFile tf;
+  char block[4096];
+  for (size_t i = 0; i < 64; ++i) {
+    memset(block, 'a' + (i % 26), sizeof(block));
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(block)), write(tf.fd, block, sizeof(block)));
+  }
+
+  FILE* fp = fdopen(tf.fd, "r");
+  ASSERT_TRUE(fp != NULL);
+  ASSERT_EQ(0, fseek(fp, 0, SEEK_SET));
+
+  for (size_t i = 0; i < 64; ++i) {
+    ASSERT_EQ(1U, fread(block, sizeof(block), 1, fp));
+    ASSERT_EQ('a' + static_cast<int>(i % 26), block[0]);
+    ASSERT_EQ('a' + static_cast<int>(i % 26), block[sizeof(block) - 1]);
+  }
+  ASSERT_EQ(EOF, fgetc(fp));
+  ASSERT_TRUE(feof(fp));
+
+  ASSERT_EQ(0, fseek(fp, 5 * sizeof(block) + 1, SEEK_SET));
+  ASSERT_EQ('f', fgetc(fp));
+  ASSERT_EQ(static_cast<long>(5 * sizeof(block) + 2), ftell(fp));
+
+  ASSERT_EQ(0, fseek(fp, -1, SEEK_END));
+  ASSERT_EQ('a' + 63 % 26, fgetc(fp));
+
+  fclose(fp);
+}
+
+TEST(stdio, fflush_NULL_many_streams) {
+  // FILEs come from a free list, and fflush(NULL) only walks streams that
+  // may hold output. Check that released and reused slots are handled.
+  const size_t kCount = 100;
+  TemporaryFile tfs[kCount];
+  FILE* fps[kCount];
+  for (size_t i = 0; i < kCount; ++i) {
+    fps[i] = fdopen(tfs[i].fd, (i % 2 == 0) ? "w" : "r");
+    ASSERT_TRUE(fps[i] != NULL);
+    if (i % 2 == 0) {
+      ASSERT_EQ(1, fprintf(fps[i], "%c", static_cast<char>('a' + i % 26)));
+    }
+  }
+  // Release some writers and reuse their slots for new writers.
+  for (size_t i = 0; i < kCount; i += 4) {
+    ASSERT_EQ(0, fclose(fps[i]));
+    fps[i] = fopen(tfs[i].filename, "a");
+    ASSERT_TRUE(fps[i] != NULL);
+    ASSERT_EQ(1, fprintf(fps[i], "%c", static_cast<char>('A' + i % 26)));
+  }
+
+  ASSERT_EQ(0, fflush(NULL));
+
+  for (size_t i = 0; i < kCount; i += 2) {
+    int fd = open(tfs[i].filename, O_RDONLY);
+    ASSERT_NE(-1, fd);
+    char buf[4];
+    memset(buf, 0, sizeof(buf));
+    ASSERT_EQ((i % 4 == 0) ? 2 : 1, read(fd, buf, sizeof(buf)));
+    ASSERT_EQ(static_cast<char>('a' + i % 26), buf[0]);
+    if (i % 4 == 0) {
+      ASSERT_EQ(static_cast<char>('A' + i % 26), buf[1]);
+    }
+    close(fd);
+  }
+  for (size_t i = 0; i < kCount; ++i) {
+    fclose(fps[i]);
+  }
+}
+
+TEST(stdio, freopen_closed_stream) {
+#if defined(__BIONIC__)
+  // freopen of an fclose'd stream is undefined, but bionic has always allowed
+  // it. The FILE mustn't end up on the free list twice, or stay there once
+  // it's in use again.
+  TemporaryFile tf;
+  FILE* fp = fopen(tf.filename, "w");
+  ASSERT_TRUE(fp != NULL);
+  ASSERT_EQ(0, fclose(fp));
+  ASSERT_TRUE(freopen("/does/not/exist", "r", fp) == NULL);
+  FILE* fp1 = fopen(tf.filename, "r");
+  ASSERT_TRUE(fp1 != NULL);
+  FILE* fp2 = fopen(tf.filename, "r");
+  ASSERT_TRUE(fp2 != NULL);
+  ASSERT_NE(fp1, fp2);
+  ASSERT_EQ(0, fclose(fp1));
+  ASSERT_EQ(0, fclose(fp2));
+
+  fp = fopen(tf.filename, "w");
+  ASSERT_TRUE(fp != NULL);
+  ASSERT_EQ(0, fclose(fp));
+  ASSERT_EQ(fp, freopen(tf.filename, "r", fp));
+  FILE* fps[20];
+  for (size_t i = 0; i < 20; ++i) {
+    fps[i] = fopen(tf.filename, "r");
+    ASSERT_TRUE(fps[i] != NULL);
+    ASSERT_NE(fp, fps[i]);
+  }
+  for (size_t i = 0; i < 20; ++i) {
+    ASSERT_EQ(0, fclose(fps[i]));
+  }
+  ASSERT_EQ(0, fclose(fp));
+#else // __BIONIC__
+  GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif // __BIONIC__
+}
+
+TEST(stdio, unlocked) {
+  TemporaryFile tf;
+  FILE* fp = fdopen(tf.fd, "w+");
+  ASSERT_TRUE(fp != NULL);
+
+  flockfile(fp);
+  ASSERT_LE(0, fputs_unlocked("hello\n", fp));
+  ASSERT_EQ(1U, fwrite_unlocked("world\n", 6, 1, fp));
+  ASSERT_EQ('x', fputc_unlocked('x', fp));
+  ASSERT_EQ(0, fflush_unlocked(fp));
+  ASSERT_EQ(tf.fd, fileno_unlocked(fp));
+  funlockfile(fp);
+
+  rewind(fp);
+
+  flockfile(fp);
+  char buf[16];
+  ASSERT_EQ(buf, fgets_unlocked(buf, sizeof(buf), fp));
+  ASSERT_STREQ("hello\n", buf);
+  ASSERT_EQ(1U, fread_unlocked(buf, 6, 1, fp));
+  ASSERT_EQ(0, memcmp(buf, "world\n", 6));
+  ASSERT_EQ('x', fgetc_unlocked(fp));
+  ASSERT_FALSE(feof_unlocked(fp));
+  ASSERT_EQ(EOF, fgetc_unlocked(fp));
+  ASSERT_TRUE(feof_unlocked(fp));
+  ASSERT_FALSE(ferror_unlocked(fp));
+  clearerr_unlocked(fp);
+  ASSERT_FALSE(feof_unlocked(fp));
+  funlockfile(fp);
+
+  fclose(fp);
+}
+
+TEST(stdio, fmemopen) {
+  char buf[16];
+  memset(buf, 'x', sizeof(buf));
+  FILE* fp = fmemopen(buf, sizeof(buf), "w+");
+  ASSERT_TRUE(fp != NULL);
+  ASSERT_EQ(-1, fileno(fp));
+
+  ASSERT_EQ(9, fprintf(fp, "%s %d", "hello", 123));
+  ASSERT_EQ(0, fflush(fp));
+  ASSERT_STREQ("hello 123", buf);
+  ASSERT_EQ(9, ftell(fp));
+
+  rewind(fp);
+  char line[16];
+  ASSERT_EQ(line, fgets(line, sizeof(line), fp));
+  ASSERT_STREQ("hello 123", line);
+  ASSERT_EQ(EOF, fgetc(fp));
+  ASSERT_TRUE(feof(fp));
+
+  ASSERT_EQ(0, fseek(fp, 6, SEEK_SET));
+  ASSERT_EQ('1', fgetc(fp));
+  ASSERT_EQ(0, fseek(fp, 0, SEEK_CUR));
+  ASSERT_EQ('x', fputc('x', fp));
+  ASSERT_EQ(0, fflush(fp));
+  ASSERT_STREQ("hello 1x3", buf);
+
+  fclose(fp);
+}
+
+TEST(stdio, fmemopen_read) {
+  char buf[] = "first line\nsecond line\n";
+  FILE* fp = fmemopen(buf, strlen(buf), "r");
+  ASSERT_TRUE(fp != NULL);
+
+  char line[32];
+  ASSERT_EQ(line, fgets(line, sizeof(line), fp));
+  ASSERT_STREQ("first line\n", line);
+  ASSERT_EQ(11, ftell(fp));
+  ASSERT_EQ(1U, fread(line, 12, 1, fp));
+  ASSERT_EQ(0, memcmp(line, "second line\n", 12));
+  ASSERT_EQ(0U, fread(line, 1, 1, fp));
+  ASSERT_TRUE(feof(fp));
+
+  // Reading doesn't modify the buffer.
+  ASSERT_STREQ("first line\nsecond line\n", buf);
+
+  // A read-only stream can't be written.
+  ASSERT_EQ(EOF, fputc('x', fp));
+  fclose(fp);
+}
+
+TEST(stdio, fmemopen_full) {
+  char buf[8];
+  FILE* fp = fmemopen(buf, sizeof(buf), "w");
+  ASSERT_TRUE(fp != NULL);
+
+  fwrite("0123456789", 10, 1, fp);
+  fflush(fp);
+  ASSERT_TRUE(ferror(fp));
+  // The last byte is kept for the NUL.
+  ASSERT_STREQ("0123456", buf);
+  fclose(fp);
+}
+
+TEST(stdio, fmemopen_append) {
+  char buf[16] = "abc";
+  FILE* fp = fmemopen(buf, sizeof(buf), "a");
+  ASSERT_TRUE(fp != NULL);
+  ASSERT_EQ(3, ftell(fp));
+  ASSERT_LE(0, fputs("def", fp));
+  fclose(fp);
+  ASSERT_STREQ("abcdef", buf);
+}
+
+TEST(stdio, fmemopen_append_after_seek) {
+  char buf[16] = "hello";
+  FILE* fp = fmemopen(buf, sizeof(buf), "a");
+  ASSERT_TRUE(fp != NULL);
+  ASSERT_EQ(0, fseek(fp, 0, SEEK_SET));
+  ASSERT_LE(0, fputs("XY", fp));
+  ASSERT_EQ(0, fflush(fp));
+  ASSERT_STREQ("helloXY", buf);
+  ASSERT_EQ(7, ftell(fp));
+  fclose(fp);
+
+  // Reading an "a+" stream happens where we seek to; writing still appends.
+  strcpy(buf, "hello");
+  fp = fmemopen(buf, sizeof(buf), "a+");
+  ASSERT_TRUE(fp != NULL);
+  ASSERT_EQ(0, fseek(fp, 1, SEEK_SET));
+  ASSERT_EQ('e', fgetc(fp));
+  ASSERT_EQ(0, fseek(fp, 0, SEEK_SET));
+  ASSERT_LE(0, fputs("XY", fp));
+  fclose(fp);
+  ASSERT_STREQ("helloXY", buf);
+}
+
+TEST(stdio, fmemopen_EINVAL) {
+  char buf[16];
+#if defined(__BIONIC__)
+  errno = 0;
+  ASSERT_TRUE(fmemopen(buf, 0, "r") == NULL);
+  ASSERT_EQ(EINVAL, errno);
+#endif
+  errno = 0;
+  ASSERT_TRUE(fmemopen(buf, sizeof(buf), "q") == NULL);
+  ASSERT_EQ(EINVAL, errno);
+}
+
+TEST(stdio, open_memstream) {
+  char* p = NULL;
+  size_t size = 0;
+  FILE* fp = open_memstream(&p, &size);
+  ASSERT_TRUE(fp != NULL);
+
+  ASSERT_EQ(5, fprintf(fp, "hello"));
+  ASSERT_EQ(0, fflush(fp));
+  ASSERT_EQ(5U, size);
+  ASSERT_STREQ("hello", p);
+
+  // Grow well past the initial buffer.
+  for (int i = 0; i < 10000; ++i) {
+    ASSERT_EQ(8, fprintf(fp, " %07d", i));
+  }
+  ASSERT_EQ(0, fflush(fp));
+  ASSERT_EQ(5U + 10000 * 8, size);
+  ASSERT_EQ(strlen(p), size);
+  ASSERT_EQ(0, memcmp(p, "hello 0000000 0000001", 21));
+  ASSERT_STREQ(" 0009999", p + size - 8);
+
+  // Seeking back reports the shorter size.
+  ASSERT_EQ(0, fseek(fp, 5, SEEK_SET));
+  ASSERT_EQ(0, fflush(fp));
+  ASSERT_EQ(5U, size);
+
+  fclose(fp);
+  ASSERT_EQ(5U, size);
+  free(p);
+}
+
+TEST(stdio, open_memstream_EINVAL) {
+#if defined(__BIONIC__)
+  char* p;
+  size_t size;
+  errno = 0;
+  ASSERT_TRUE(open_memstream(NULL, &size) == NULL);
+  ASSERT_EQ(EINVAL, errno);
+  errno = 0;
+  ASSERT_TRUE(open_memstream(&p, NULL) == NULL);
+  ASSERT_EQ(EINVAL, errno);
+#else // __BIONIC__
+  GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif // __BIONIC__
+}
+
+struct CookieBuffer {
+  std::string data;
+  size_t pos;
+  bool closed;
+};
+
+static ssize_t CookieRead(void* cookie, char* buf, size_t size) {
+  CookieBuffer* cb = reinterpret_cast<CookieBuffer*>(cookie);
+  size_t n = cb->data.size() - cb->pos;
+  if (n > size) {
+    n = size;
+  }
+  memcpy(buf, cb->data.data() + cb->pos, n);
+  cb->pos += n;
+  return n;
+}
+
+static ssize_t CookieWrite(void* cookie, const char* buf, size_t size) {
+  CookieBuffer* cb = reinterpret_cast<CookieBuffer*>(cookie);
+  cb->data.replace(cb->pos, size, buf, size);
+  cb->pos += size;
+  return size;
+}
+
+static int CookieSeek(void* cookie, off64_t* offset, int whence) {
+  CookieBuffer* cb = reinterpret_cast<CookieBuffer*>(cookie);
+  if (whence == SEEK_SET) {
+    cb->pos = *offset;
+  } else if (whence == SEEK_CUR) {
+    cb->pos += *offset;
+  } else {
+    cb->pos = cb->data.size() + *offset;
+  }
+  *offset = cb->pos;
+  return 0;
+}
+
+static int CookieClose(void* cookie) {
+  reinterpret_cast<CookieBuffer*>(cookie)->closed = true;
+  return 0;
+}
+
+TEST(stdio, fopencookie) {
+  CookieBuffer cb;
+  cb.data = "existing";
+  cb.pos = 0;
+  cb.closed = false;
+  cookie_io_functions_t io = { CookieRead, CookieWrite, CookieSeek, CookieClose };
+
+  FILE* fp = fopencookie(&cb, "r+", io);
+  ASSERT_TRUE(fp != NULL);
+  char buf[16];
+  ASSERT_EQ(buf, fgets(buf, sizeof(buf), fp));
+  ASSERT_STREQ("existing", buf);
+
+  ASSERT_EQ(0, fseek(fp, 0, SEEK_END));
+  ASSERT_EQ(8, ftell(fp));
+  ASSERT_EQ(6, fprintf(fp, " %d", 12345));
+  ASSERT_EQ(0, fflush(fp));
+  ASSERT_EQ("existing 12345", cb.data);
+
+  ASSERT_FALSE(cb.closed);
+  ASSERT_EQ(0, fclose(fp));
+  ASSERT_TRUE(cb.closed);
+}
+
+TEST(stdio, fopencookie_no_functions) {
+  cookie_io_functions_t io = { NULL, NULL, NULL, NULL };
+
+  // No read function means EOF.
+  FILE* fp = fopencookie(NULL, "r", io);
+  ASSERT_TRUE(fp != NULL);
+  ASSERT_EQ(EOF, fgetc(fp));
+  // No seek function means the stream isn't seekable.
+  ASSERT_EQ(-1, fseek(fp, 0, SEEK_SET));
+  ASSERT_EQ(0, fclose(fp));
+
+#if defined(__BIONIC__)
+  // No write function means output is discarded. (This is what glibc documents,
+  // but glibc actually reports an error.)
+  fp = fopencookie(NULL, "w", io);
+  ASSERT_TRUE(fp != NULL);
+  ASSERT_EQ(3, fprintf(fp, "abc"));
+  ASSERT_EQ(0, fflush(fp));
+  ASSERT_EQ(0, fclose(fp));
+#endif
+}
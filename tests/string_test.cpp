@@ -794,6 +794,83 @@ TEST(string, memrchr) {
   }
 }
 
+TEST(string, memmem) {
+  const char* haystack = "abcabcabd";
+  ASSERT_TRUE(memmem(haystack, 9, "abd", 3) == haystack + 6);
+  ASSERT_TRUE(memmem(haystack, 9, "c", 1) == haystack + 2);
+  ASSERT_TRUE(memmem(haystack, 9, "abcabcabd", 9) == haystack);
+  ASSERT_TRUE(memmem(haystack, 8, "abd", 3) == NULL);
+  ASSERT_TRUE(memmem(haystack, 9, "abcabcabdx", 10) == NULL);
+  ASSERT_TRUE(memmem("a\0b\0c", 5, "b\0c", 3) != NULL);
+}
+
+TEST(string, strstr) {
+  const char* haystack = "abcabcabd";
+  ASSERT_TRUE(strstr(haystack, "abd") == haystack + 6);
+  ASSERT_TRUE(strstr(haystack, "c") == haystack + 2);
+  ASSERT_TRUE(strstr(haystack, "") == haystack);
+  ASSERT_TRUE(strstr(haystack, haystack) == haystack);
+  ASSERT_TRUE(strstr(haystack, "abcabcabdx") == NULL);
+  ASSERT_TRUE(strstr("", "a") == NULL);
+}
+
+// Small alphabets and periodic needles are what the Two-Way fallback in
+// memmem and strstr is for, and where it's easiest to get wrong.
+TEST(string, memmem_strstr_random) {
+  const size_t kMaxHaystack = 512;
+  const size_t kMaxNeedle = 32;
+  char haystack[kMaxHaystack + 1];
+  char needle[kMaxNeedle + 1];
+  for (size_t iter = 0; iter < 100000; ++iter) {
+    int alphabet = 1 + random() % 3;
+    size_t n = random() % (iter % 8 == 0 ? kMaxHaystack : 40);
+    size_t m = 1 + random() % (iter % 4 == 0 ? kMaxNeedle : 8);
+    for (size_t i = 0; i < n; ++i) {
+      haystack[i] = 'a' + random() % alphabet;
+    }
+    size_t period = 1 + random() % 4;
+    for (size_t i = 0; i < m; ++i) {
+      needle[i] = (i < period) ? 'a' + random() % alphabet : needle[i - period];
+    }
+    if (random() % 2) {
+      needle[random() % m] = 'a' + random() % alphabet;
+    }
+    haystack[n] = needle[m] = '\0';
+
+    char* expected = NULL;
+    for (size_t i = 0; i + m <= n; ++i) {
+      if (memcmp(haystack + i, needle, m) == 0) {
+        expected = haystack + i;
+        break;
+      }
+    }
+    ASSERT_TRUE(memmem(haystack, n, needle, m) == expected);
+    ASSERT_TRUE(strstr(haystack, needle) == expected);
+  }
+}
+
+TEST(string, memmem_strstr_worst_case) {
+  // "aaa...a" against "aaa...ab" is quadratic for a naive search.
+  const size_t kHaystack = 4*1024*1024;
+  const size_t kNeedle = 4096;
+  char* haystack = new char[kHaystack + 1];
+  memset(haystack, 'a', kHaystack);
+  haystack[kHaystack] = '\0';
+  char* needle = new char[kNeedle + 1];
+  memset(needle, 'a', kNeedle - 1);
+  needle[kNeedle - 1] = 'b';
+  needle[kNeedle] = '\0';
+
+  ASSERT_TRUE(memmem(haystack, kHaystack, needle, kNeedle) == NULL);
+  ASSERT_TRUE(strstr(haystack, needle) == NULL);
+  haystack[kHaystack - 1] = 'b';
+  ASSERT_TRUE(memmem(haystack, kHaystack, needle, kNeedle) == haystack + kHaystack - kNeedle);
+  ASSERT_TRUE(strstr(haystack, needle) == haystack + kHaystack - kNeedle);
+
+  delete[] haystack;
+  delete[] needle;
+}
+
 TEST(string, memcmp) {
   StringTestState<char> state(SMALL);
   for (size_t i = 0; i < state.n; i++) {
@@ -934,6 +1011,73 @@ TEST(string, memmove_cache_size) {
   free(glob_ptr2);
 }
 
+// Big enough to be past the last-level cache, where memcpy and memset switch
+// to non-temporal stores.
+#define LLC_DATA_SIZE (64*1024*1024)
+
+TEST(string, memcpy_llc_size) {
+  char* src = reinterpret_cast<char*>(malloc(LLC_DATA_SIZE));
+  ASSERT_TRUE(src != NULL);
+  char* dst = reinterpret_cast<char*>(malloc(LLC_DATA_SIZE));
+  ASSERT_TRUE(dst != NULL);
+  for (size_t i = 0; i < LLC_DATA_SIZE; i++) {
+    src[i] = (i + 1) % 251;
+  }
+
+  size_t offsets[] = {0, 1, 15, 33, 63};
+  for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+    size_t len = LLC_DATA_SIZE - 64 - offsets[i];
+    memset(dst, 0, LLC_DATA_SIZE);
+    ASSERT_EQ(dst + 64, memcpy(dst + 64, src + offsets[i], len));
+    ASSERT_EQ(0, memcmp(dst + 64, src + offsets[i], len));
+    for (size_t j = 0; j < 64; j++) {
+      ASSERT_EQ(0, dst[j]);
+    }
+  }
+  free(src);
+  free(dst);
+}
+
+TEST(string, memset_llc_size) {
+  unsigned char* buf = reinterpret_cast<unsigned char*>(malloc(LLC_DATA_SIZE));
+  ASSERT_TRUE(buf != NULL);
+
+  size_t offsets[] = {0, 1, 15, 33, 63};
+  for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+    int value = (i % 2 == 0) ? 0 : 0xa5;
+    size_t len = LLC_DATA_SIZE - 128 - offsets[i];
+    memset(buf, 0x11, LLC_DATA_SIZE);
+    ASSERT_EQ(buf + offsets[i], memset(buf + offsets[i], value, len));
+    // Check every byte near the ends of the fill, where the alignment and
+    // tail code are, and a sample of the bytes in between.
+    size_t end = offsets[i] + len;
+    for (size_t j = 0; j < LLC_DATA_SIZE; j = (j > 4096 && j + 4096 < end) ? j + 4093 : j + 1) {
+      bool inside = j >= offsets[i] && j < end;
+      ASSERT_EQ(inside ? value : 0x11, buf[j]) << "offset " << offsets[i] << ", byte " << j;
+    }
+  }
+  free(buf);
+}
+
+// A copy or fill this big takes the streaming path on any machine, which
+// mustn't disturb errno.
+TEST(string, memcpy_memset_large_errno) {
+  const size_t size = 1024 * 1024;
+  char* src = reinterpret_cast<char*>(malloc(size));
+  ASSERT_TRUE(src != NULL);
+  char* dst = reinterpret_cast<char*>(malloc(size));
+  ASSERT_TRUE(dst != NULL);
+
+  errno = EDOM;
+  memset(src, 0x5a, size);
+  ASSERT_EQ(EDOM, errno);
+  memcpy(dst, src, size);
+  ASSERT_EQ(EDOM, errno);
+  ASSERT_EQ(0, memcmp(dst, src, size));
+  free(src);
+  free(dst);
+}
+
 static void verify_memmove(char* src_copy, char* dst, char* src, size_t size) {
   memset(dst, 0, size);
   memcpy(src, src_copy, size);
@@ -1287,3 +1431,95 @@ TEST(string, strchr_align) {
 TEST(string, strchr_overread) {
   RunSingleBufferOverreadTest(DoStrchrTest);
 }
+
+static void DoStrrchrTest(uint8_t* buf, size_t len) {
+  if (len >= 1) {
+    char value = 32 + (len % 96);
+    char search_value = 33 + (len % 96);
+    memset(buf, value, len - 1);
+    buf[len-1] = '\0';
+    ASSERT_EQ(NULL, strrchr(reinterpret_cast<char*>(buf), search_value));
+    ASSERT_EQ(reinterpret_cast<char*>(&buf[len-1]), strrchr(reinterpret_cast<char*>(buf), '\0'));
+    if (len >= 2) {
+      buf[0] = search_value;
+      ASSERT_EQ(reinterpret_cast<char*>(&buf[0]), strrchr(reinterpret_cast<char*>(buf), search_value));
+      buf[len-2] = search_value;
+      ASSERT_EQ(reinterpret_cast<char*>(&buf[len-2]), strrchr(reinterpret_cast<char*>(buf), search_value));
+    }
+  }
+}
+
+TEST(string, strrchr_align) {
+  RunSingleBufferAlignTest(MEDIUM, DoStrrchrTest);
+}
+
+TEST(string, strrchr_overread) {
+  RunSingleBufferOverreadTest(DoStrrchrTest);
+}
+
+static void DoMemchrTest(uint8_t* buf, size_t len) {
+  if (len >= 1) {
+    int value = len % 128;
+    int search_value = (len % 128) + 1;
+    memset(buf, value, len);
+    ASSERT_EQ(NULL, memchr(buf, search_value, len));
+    buf[len-1] = search_value;
+    ASSERT_EQ(buf + len - 1, memchr(buf, search_value, len));
+    ASSERT_EQ(NULL, memchr(buf, search_value, len - 1));
+    buf[0] = search_value;
+    ASSERT_EQ(buf, memchr(buf, search_value, len));
+  }
+}
+
+TEST(string, memchr_align) {
+  RunSingleBufferAlignTest(MEDIUM, DoMemchrTest);
+}
+
+TEST(string, memchr_overread) {
+  RunSingleBufferOverreadTest(DoMemchrTest);
+}
+
+static void DoMemrchrTest(uint8_t* buf, size_t len) {
+  if (len >= 1) {
+    int value = len % 128;
+    int search_value = (len % 128) + 1;
+    memset(buf, value, len);
+    ASSERT_EQ(NULL, memrchr(buf, search_value, len));
+    buf[0] = search_value;
+    ASSERT_EQ(buf, memrchr(buf, search_value, len));
+    ASSERT_EQ(NULL, memrchr(buf + 1, search_value, len - 1));
+    buf[len-1] = search_value;
+    ASSERT_EQ(buf + len - 1, memrchr(buf, search_value, len));
+  }
+}
+
+TEST(string, memrchr_align) {
+  RunSingleBufferAlignTest(MEDIUM, DoMemrchrTest);
+}
+
+TEST(string, memrchr_overread) {
+  RunSingleBufferOverreadTest(DoMemrchrTest);
+}
+
+TEST(string, memrchr_underread) {
+  RunSingleBufferUnderreadTest(DoMemrchrTest);
+}
+
+static void DoStrnlenTest(uint8_t* buf, size_t len) {
+  if (len >= 1) {
+    memset(buf, (32 + (len % 96)), len);
+    ASSERT_EQ(len, strnlen(reinterpret_cast<char*>(buf), len));
+    buf[len-1] = '\0';
+    ASSERT_EQ(len-1, strnlen(reinterpret_cast<char*>(buf), len));
+    ASSERT_EQ(len-1, strnlen(reinterpret_cast<char*>(buf), SIZE_MAX));
+    ASSERT_EQ(len/2, strnlen(reinterpret_cast<char*>(buf), len/2));
+  }
+}
+
+TEST(string, strnlen_align) {
+  RunSingleBufferAlignTest(MEDIUM, DoStrnlenTest);
+}
+
+TEST(string, strnlen_overread) {
+  RunSingleBufferOverreadTest(DoStrnlenTest);
+}
@@ -15,10 +15,16 @@
  */
 
 #include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 #include <errno.h>
+#include <stdio.h>
+#include <time.h>
 #include <unistd.h>
 #include <string>
+#include <utility>
+#include <vector>
 
 #if defined(__BIONIC__)
 
@@ -63,6 +69,7 @@ struct LocalPropertyTestState {
     }
 public:
     bool valid;
+    const std::string& filename() const { return pa_filename; }
 private:
     std::string pa_dirname;
     std::string pa_filename;
@@ -113,6 +120,73 @@ static void *PropertyWaitHelperFn(void *arg) {
     return NULL;
 }
 
+static void PropertyReadCallback(void *cookie, const char *name, const char *value,
+                                 unsigned serial __attribute__((unused))) {
+    std::pair<std::string, std::string> *read =
+            static_cast<std::pair<std::string, std::string> *>(cookie);
+    read->first = name;
+    read->second = value;
+}
+
+// A stand-in for init's property service that handles one connection.
+struct LocalPropertyService {
+    LocalPropertyService(bool batches) : batches(batches), fd(-1) {
+        const char* ANDROID_DATA = getenv("ANDROID_DATA");
+        char path[sizeof(sockaddr_un::sun_path)];
+        snprintf(path, sizeof(path), "%s/local/tmp/prop-service-%d", ANDROID_DATA, getpid());
+        socket_path = path;
+        unlink(path);
+
+        fd = socket(AF_LOCAL, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_LOCAL;
+        strcpy(addr.sun_path, path);
+        if (fd == -1 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == -1 ||
+                listen(fd, 1) == -1) {
+            fprintf(stderr, "making local property service failed: %s", strerror(errno));
+            return;
+        }
+        __system_property_set_service_socket(path);
+        pthread_create(&thread, NULL, Serve, this);
+    }
+
+    ~LocalPropertyService() {
+        pthread_join(thread, NULL);
+        __system_property_set_service_socket("/dev/socket/" PROP_SERVICE_NAME);
+        close(fd);
+        unlink(socket_path.c_str());
+    }
+
+    static void* Serve(void* arg) {
+        LocalPropertyService* service = reinterpret_cast<LocalPropertyService*>(arg);
+        const int client = accept(service->fd, NULL, NULL);
+        prop_msg msg;
+        int32_t failures = 0;
+        while (recv(client, &msg, sizeof(msg), MSG_WAITALL) == sizeof(msg)) {
+            if (!service->batches || msg.cmd == PROP_MSG_BATCH_END) {
+                break;
+            }
+            service->set.push_back(std::make_pair(msg.name, msg.value));
+            if (strncmp(msg.name, "bad.", 4) == 0) {
+                failures++;
+            }
+        }
+        if (service->batches) {
+            send(client, &failures, sizeof(failures), 0);
+        }
+        close(client);
+        return NULL;
+    }
+
+    std::vector<std::pair<std::string, std::string> > set;
+private:
+    bool batches;
+    int fd;
+    pthread_t thread;
+    std::string socket_path;
+};
+
 #endif // __BIONIC__
 
 TEST(properties, add) {
@@ -176,6 +250,39 @@ TEST(properties, update) {
 #endif // __BIONIC__
 }
 
+TEST(properties, update_many) {
+#if defined(__BIONIC__)
+    LocalPropertyTestState pa;
+    ASSERT_TRUE(pa.valid);
+
+    ASSERT_EQ(0, __system_property_add("property", 8, "value", 5));
+    prop_info *pi = const_cast<prop_info*>(__system_property_find("property"));
+    ASSERT_NE((prop_info *)NULL, pi);
+
+    // Each update adds two to the count in the serial, so this takes it past
+    // bit 16 (which marks long values) more than once.
+    char value[PROP_VALUE_MAX];
+    unsigned int serial = __system_property_serial(pi);
+    for (size_t i = 0; i < 100000; ++i) {
+        int len = snprintf(value, sizeof(value), "value%zu", i);
+        ASSERT_EQ(0, __system_property_update(pi, value, len));
+        unsigned int new_serial = __system_property_serial(pi);
+        ASSERT_NE(serial, new_serial);
+        serial = new_serial;
+    }
+
+    char propvalue[PROP_VALUE_MAX];
+    ASSERT_EQ(10, __system_property_get("property", propvalue));
+    ASSERT_STREQ("value99999", propvalue);
+    std::pair<std::string, std::string> read;
+    ASSERT_EQ(0, __system_property_read_callback(pi, PropertyReadCallback, &read));
+    ASSERT_EQ("property", read.first);
+    ASSERT_EQ("value99999", read.second);
+#else // __BIONIC__
+    GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif // __BIONIC__
+}
+
 TEST(properties, fill) {
 #if defined(__BIONIC__)
     LocalPropertyTestState pa;
@@ -357,6 +464,32 @@ TEST(properties, serial) {
 #endif // __BIONIC__
 }
 
+TEST(properties, handle) {
+#if defined(__BIONIC__)
+    LocalPropertyTestState pa;
+    ASSERT_TRUE(pa.valid);
+    prop_handle handle = PROP_HANDLE_INITIALIZER("property");
+
+    // A handle works before its property exists.
+    ASSERT_STREQ("", __system_property_handle_get(&handle));
+    ASSERT_EQ(0, __system_property_add("other_property", 14, "value1", 6));
+    ASSERT_STREQ("", __system_property_handle_get(&handle));
+
+    ASSERT_EQ(0, __system_property_add("property", 8, "value2", 6));
+    ASSERT_STREQ("value2", __system_property_handle_get(&handle));
+    ASSERT_STREQ("value2", __system_property_handle_get(&handle));
+
+    prop_info *pi = (prop_info *)__system_property_find("property");
+    ASSERT_NE((prop_info *)NULL, pi);
+    ASSERT_EQ(0, __system_property_update(pi, "value3", 6));
+    ASSERT_STREQ("value3", __system_property_handle_get(&handle));
+    ASSERT_EQ(0, __system_property_update(pi, "", 0));
+    ASSERT_STREQ("", __system_property_handle_get(&handle));
+#else // __BIONIC__
+    GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif // __BIONIC__
+}
+
 TEST(properties, wait) {
 #if defined(__BIONIC__)
     LocalPropertyTestState pa;
@@ -385,6 +518,146 @@ TEST(properties, wait) {
 #endif // __BIONIC__
 }
 
+TEST(properties, wait_property) {
+#if defined(__BIONIC__)
+    LocalPropertyTestState pa;
+    ASSERT_TRUE(pa.valid);
+    pthread_t t;
+    int flag = 0;
+
+    ASSERT_EQ(0, __system_property_add("property", 8, "value1", 6));
+    ASSERT_EQ(0, __system_property_add("other_property", 14, "value2", 6));
+    prop_info *pi = (prop_info *)__system_property_find("property");
+    ASSERT_NE((prop_info *)NULL, pi);
+    prop_info *other_pi = (prop_info *)__system_property_find("other_property");
+    ASSERT_NE((prop_info *)NULL, other_pi);
+    unsigned int serial = __system_property_serial(pi);
+
+    // Updating a different property doesn't count.
+    ASSERT_EQ(0, __system_property_update(other_pi, "value3", 6));
+    unsigned int new_serial = 0;
+    timespec timeout = { 0, 10000000 };
+    ASSERT_EQ(0, __system_property_wait(pi, serial, &new_serial, &timeout));
+
+    ASSERT_EQ(0, pthread_create(&t, NULL, PropertyWaitHelperFn, &flag));
+    ASSERT_EQ(1, __system_property_wait(pi, serial, &new_serial, NULL));
+    ASSERT_EQ(flag, 1);
+    ASSERT_NE(serial, new_serial);
+    ASSERT_EQ(new_serial, __system_property_serial(pi));
+
+    char propvalue[PROP_VALUE_MAX];
+    ASSERT_EQ(6, __system_property_read(pi, NULL, propvalue));
+    ASSERT_STREQ("value3", propvalue);
+
+    void* result;
+    ASSERT_EQ(0, pthread_join(t, &result));
+#else // __BIONIC__
+    GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif // __BIONIC__
+}
+
+TEST(properties, add_area) {
+#if defined(__BIONIC__)
+    LocalPropertyTestState pa;
+    ASSERT_TRUE(pa.valid);
+
+    ASSERT_EQ(-1, __system_property_add_area("bad/prefix.", 4096));
+    ASSERT_EQ(0, __system_property_add_area("long.", 64 * 1024));
+    ASSERT_EQ(-1, __system_property_add_area("long.", 64 * 1024));
+    std::string area_filename = pa.filename() + ".long.";
+
+    ASSERT_EQ(0, __system_property_add("property", 8, "value1", 6));
+
+    std::string name = "long." + std::string(100, 'n');
+    std::string value(1000, 'v');
+    ASSERT_EQ(0, __system_property_add(name.c_str(), name.size(), value.c_str(), value.size()));
+
+    // Long names and values are only allowed in the extra area.
+    std::string main_name(100, 'n');
+    ASSERT_EQ(-1, __system_property_add(main_name.c_str(), main_name.size(), "value", 5));
+    ASSERT_EQ(-1, __system_property_add("other", 5, value.c_str(), value.size()));
+
+    const prop_info *pi = __system_property_find(name.c_str());
+    ASSERT_NE((const prop_info *)NULL, pi);
+    std::pair<std::string, std::string> read;
+    ASSERT_EQ(0, __system_property_read_callback(pi, PropertyReadCallback, &read));
+    ASSERT_EQ(name, read.first);
+    ASSERT_EQ(value, read.second);
+
+    char propvalue[PROP_VALUE_MAX];
+    ASSERT_LT(0, __system_property_get(name.c_str(), propvalue));
+    ASSERT_STRNE(value.c_str(), propvalue);
+    ASSERT_EQ(-1, __system_property_update(const_cast<prop_info*>(pi), "value", 5));
+
+    ASSERT_EQ(6, __system_property_get("property", propvalue));
+    ASSERT_STREQ("value1", propvalue);
+
+    size_t count = 0;
+    ASSERT_EQ(0, __system_property_foreach(foreach_test_callback, &count));
+    ASSERT_EQ(2U, count);
+
+    ASSERT_EQ(0, unlink(area_filename.c_str()));
+#else // __BIONIC__
+    GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif // __BIONIC__
+}
+
+TEST(properties, set_batch) {
+#if defined(__BIONIC__)
+    const char* keys[] = { "batch.one", "batch.two", "batch.three" };
+    const char* values[] = { "1", NULL, "3" };
+    {
+        LocalPropertyService service(true);
+        ASSERT_EQ(0, __system_property_set_batch(keys, values, 3));
+        ASSERT_EQ(3U, service.set.size());
+        ASSERT_EQ("batch.one", service.set[0].first);
+        ASSERT_EQ("1", service.set[0].second);
+        ASSERT_EQ("batch.two", service.set[1].first);
+        ASSERT_EQ("", service.set[1].second);
+        ASSERT_EQ("batch.three", service.set[2].first);
+    }
+
+    // More properties than are sent at a time.
+    std::vector<std::string> names;
+    std::vector<const char*> many_keys;
+    for (size_t i = 0; i < 100; ++i) {
+        char name[PROP_NAME_MAX];
+        snprintf(name, sizeof(name), "batch.%zu", i);
+        names.push_back(name);
+    }
+    for (size_t i = 0; i < names.size(); ++i) {
+        many_keys.push_back(names[i].c_str());
+    }
+    std::vector<const char*> many_values(names.size(), "value");
+    {
+        LocalPropertyService service(true);
+        ASSERT_EQ(0, __system_property_set_batch(&many_keys[0], &many_values[0], names.size()));
+        ASSERT_EQ(names.size(), service.set.size());
+        ASSERT_EQ("batch.99", service.set[99].first);
+    }
+
+    // The property service couldn't set one of them.
+    const char* bad_keys[] = { "batch.one", "bad.two" };
+    {
+        LocalPropertyService service(true);
+        ASSERT_EQ(-1, __system_property_set_batch(bad_keys, values, 2));
+        ASSERT_EQ(2U, service.set.size());
+    }
+
+    // The property service doesn't know about batches.
+    {
+        LocalPropertyService service(false);
+        ASSERT_EQ(-1, __system_property_set_batch(keys, values, 3));
+    }
+
+    // Names that are too long are rejected before connecting.
+    const char* long_keys[] = { "batch.aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa" };
+    ASSERT_EQ(-1, __system_property_set_batch(long_keys, values, 1));
+#else // __BIONIC__
+    GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif // __BIONIC__
+}
+
 class KilledByFault {
     public:
         explicit KilledByFault() {};
@@ -461,6 +461,35 @@ TEST(wchar, wmemmove) {
   EXPECT_STREQ(L"This This is a test of something or other", wstr);
 }
 
+TEST(wchar, wcslen_wcschr_wcsrchr) {
+  // Try every length and start position in the first few vector-sized blocks.
+  wchar_t buf[128];
+  for (size_t start = 0; start < 8; ++start) {
+    for (size_t len = 0; len < 64; ++len) {
+      wchar_t* s = buf + start;
+      wmemset(buf, L'a', sizeof(buf)/sizeof(wchar_t));
+      s[len] = L'\0';
+
+      ASSERT_EQ(len, wcslen(s));
+      ASSERT_EQ(s + len, wcschr(s, L'\0'));
+      ASSERT_EQ(s + len, wcsrchr(s, L'\0'));
+      ASSERT_EQ(NULL, wcschr(s, L'b'));
+      ASSERT_EQ(NULL, wcsrchr(s, L'b'));
+      if (len > 0) {
+        ASSERT_EQ(s, wcschr(s, L'a'));
+        ASSERT_EQ(s + len - 1, wcsrchr(s, L'a'));
+        s[len / 2] = L'b';
+        ASSERT_EQ(s + len / 2, wcschr(s, L'b'));
+        ASSERT_EQ(s + len / 2, wcsrchr(s, L'b'));
+        // Characters that only match in their low bits don't count.
+        s[len / 2] = L'b' + 0x10000;
+        ASSERT_EQ(NULL, wcschr(s, L'b'));
+        ASSERT_EQ(NULL, wcsrchr(s, L'b'));
+      }
+    }
+  }
+}
+
 TEST(wchar, mbrtowc_15439554) {
   // http://b/15439554
   ASSERT_STREQ("C.UTF-8", setlocale(LC_CTYPE, "C.UTF-8"));